@@ -17,105 +17,273 @@
  */
 
 #include "fzc.hpp"
+#include "fzc_devino.hpp"
+#include "fzc_memory.hpp"
+#include "fzc_mounts.hpp"
+#include "fzc_pool.hpp"
+#include "fzc_prefix.hpp"
+#include "fzc_snapshot.hpp"
+#include "fzc_stats.hpp"
+#include "fzc_topk.hpp"
+#include "fzc_trace.hpp"
+#include "fzc_uring.hpp"
 #include <filesystem>
 #include <iostream>
 #include <algorithm>
+#include <functional>
+#include <cstring>
 #include <sys/stat.h>
-#include <sys/mount.h>
 #include <sys/param.h>
+#include <sys/resource.h>
+#include <dirent.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <limits.h>
+#ifdef __APPLE__
+#include <sys/mount.h>
+#include <sys/attr.h>
+#endif
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
 #include <sstream>
-#include <future>
 #include <mutex>
 #include <unordered_set>
 
 namespace fs = std::filesystem;
 
-// Get the allocated size of a file or directory using getattrlist (macOS specific)
-uint64_t getAllocatedSize(const std::string& path) {
+#ifdef __APPLE__
+// Get the allocated size of a file or directory using getattrlistat relative to its parent.
+// False if the query failed; the caller counts the error and falls back to the stat sizes.
+// Elsewhere st_blocks already carries the allocation, so there is no counterpart.
+static bool getAllocatedSize(int dirfd, const std::string& name, uint64_t& size) {
     char buf[sizeof(uint32_t) + sizeof(uint64_t)] = {0};
     struct attrlist attrList = {};
     attrList.bitmapcount = ATTR_BIT_MAP_COUNT;
     attrList.fileattr = ATTR_FILE_ALLOCSIZE;
     *reinterpret_cast<uint32_t*>(buf) = sizeof(buf);
-    if (getattrlist(path.c_str(), &attrList, buf, sizeof(buf), 0) != 0) {
-        std::cerr << "getattrlist failed on " << path << ": " << strerror(errno) << "\n";
-        return 0;
-    }
-    uint64_t allocsize = *reinterpret_cast<uint64_t*>(buf + sizeof(uint32_t));
-    return allocsize;
-}
-
-// Helper: check if a string starts with a prefix
-inline bool startsWith(const std::string& str, const std::string& prefix) {
-    return str.length() >= prefix.length() && 
-           str.substr(0, prefix.length()) == prefix;
-}
-
-// Helper: normalize path (replace backslashes, remove trailing slashes except root)
-static std::string normalizePath(const std::string& path) {
-    std::string p = path;
-    std::replace(p.begin(), p.end(), '\\', '/');
-    while (p.length() > 1 && p.back() == '/') p.pop_back();
-    return p;
+    FZC_STAT_SCOPE(StatKind::Getattrlist);
+    if (getattrlistat(dirfd, name.c_str(), &attrList, buf, sizeof(buf), FSOPT_NOFOLLOW) != 0) return false;
+    size = *reinterpret_cast<uint64_t*>(buf + sizeof(uint32_t));
+    return true;
 }
+#endif
 
 // Helper: get filesystem type for a given path (returns e.g. "apfs", "hfs", "exfat", etc.)
 static std::string getFsType(const std::string& path) {
+#ifdef __APPLE__
     struct statfs sfs;
+    FZC_STAT_SCOPE(StatKind::Statfs);
     if (statfs(path.c_str(), &sfs) == 0) {
         return std::string(sfs.f_fstypename);
     }
+#else
+    (void)path;
+#endif
     return "";
 }
 
+// Helper: skip the "." and ".." entries returned by raw directory reads
+static inline bool isDotOrDotDot(const char* name) {
+    return name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'));
+}
+
+#ifdef __linux__
+// Layout of the records returned by getdents64 (not exported by glibc headers)
+struct LinuxDirent64 {
+    ino64_t d_ino;
+    off64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+// Read all entries of an open directory with large getdents64 calls.
+// The buffer is per thread and only used while the directory is being read.
+// Returns false if a read failed, so a truncated listing is never taken as complete.
+// keepGoing is asked after every read; when it says stop the listing ends early.
+static bool readDirectory(int fd, DirEntryList& entries, const std::function<bool()>& keepGoing) {
+    static constexpr size_t DIRENT_BUFFER_SIZE = 256 * 1024;
+    thread_local std::vector<char> buffer(DIRENT_BUFFER_SIZE);
+
+    for (;;) {
+        if (!entries.empty() && !keepGoing()) break;
+        long bytes = syscall(SYS_getdents64, fd, buffer.data(), buffer.size());
+        if (bytes < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        if (bytes == 0) break;
+        for (long offset = 0; offset < bytes;) {
+            auto* dirent = reinterpret_cast<LinuxDirent64*>(buffer.data() + offset);
+            offset += dirent->d_reclen;
+            if (isDotOrDotDot(dirent->d_name)) continue;
+            entries.push_back({dirent->d_name, dirent->d_type, {}});
+        }
+    }
+    return true;
+}
+#else
+// Portable directory read of an open directory; readdir reports d_type on macOS and BSDs
+static bool readDirectory(int fd, DirEntryList& entries, const std::function<bool()>& keepGoing) {
+    static constexpr size_t CHECK_INTERVAL = 4096;
+    int dupFd = dup(fd);
+    if (dupFd < 0) return false;
+    DIR* dir = fdopendir(dupFd);
+    if (!dir) {
+        close(dupFd);
+        return false;
+    }
+    // readdir returns null both at the end and on error; only errno tells them apart
+    errno = 0;
+    while (struct dirent* dirent = readdir(dir)) {
+        if (isDotOrDotDot(dirent->d_name)) continue;
+        entries.push_back({dirent->d_name, dirent->d_type, {}});
+        if (entries.size() % CHECK_INTERVAL == 0 && !keepGoing()) break;
+    }
+    bool complete = errno == 0;
+    closedir(dir);
+    return complete;
+}
+#endif
+
+#ifdef __linux__
+// Per-thread io_uring statx engine; a failed setup or ring is remembered so the thread stays on fstatat
+struct ThreadStatEngine {
+    std::unique_ptr<UringStatEngine> engine;
+    bool unavailable = false;
+
+    // A ring that failed part way may still hold completions indexing this batch, so it
+    // is never reused. If they could not all be reaped, the kernel may yet write into
+    // the engine's buffers: it is leaked rather than freed under the kernel.
+    void discard() {
+        if (engine->idle()) {
+            engine.reset();
+        } else {
+            (void)engine.release();
+        }
+        unavailable = true;
+    }
+};
+
+static ThreadStatEngine& threadStatEngine() {
+    thread_local ThreadStatEngine state;
+    if (!state.engine && !state.unavailable) {
+        state.engine = UringStatEngine::create();
+        state.unavailable = !state.engine;
+    }
+    return state;
+}
+#endif
+
+// Owns a directory descriptor for the lifetime of a directory scan, counted in openCount while open
+class ScopedFd {
+public:
+    explicit ScopedFd(int fd, std::atomic<int>* openCount = nullptr)
+        : m_fd(fd), m_openCount(fd >= 0 ? openCount : nullptr) {
+        if (m_openCount) m_openCount->fetch_add(1, std::memory_order_relaxed);
+    }
+    ~ScopedFd() { reset(); }
+    ScopedFd(const ScopedFd&) = delete;
+    ScopedFd& operator=(const ScopedFd&) = delete;
+    int get() const { return m_fd; }
+    void reset() {
+        if (m_fd >= 0) {
+            FZC_STAT_SCOPE(StatKind::Close);
+            close(m_fd);
+            if (m_openCount) m_openCount->fetch_sub(1, std::memory_order_relaxed);
+        }
+        m_fd = -1;
+    }
+private:
+    int m_fd;
+    std::atomic<int>* m_openCount;
+};
+
+// Helper: how many directory fds a scan may keep open; the rest of RLIMIT_NOFILE
+// is left to the pool, io_uring rings, mapped files and the host application
+static int directoryFdBudget() {
+    static constexpr rlim_t MAX_BUDGET = 4096;
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) != 0 || limit.rlim_cur == RLIM_INFINITY) return static_cast<int>(MAX_BUDGET);
+    return static_cast<int>(std::max<rlim_t>(8, std::min(MAX_BUDGET, limit.rlim_cur / 2)));
+}
+
+// Helper: build a child path for display; the kernel only ever sees bare names
+static inline std::string joinPath(const std::string& parent, const std::string& name) {
+    std::string path;
+    path.reserve(parent.size() + 1 + name.size());
+    path += parent;
+    if (path.empty() || path.back() != '/') path += '/';
+    path += name;
+    return path;
+}
+
 // Helper: get device id for a path
 static dev_t getDeviceId(const std::string& path) {
     struct stat st;
+    FZC_STAT_SCOPE(StatKind::Stat);
     if (stat(path.c_str(), &st) == 0) {
         return st.st_dev;
     }
     return 0;
 }
 
-// Check if a path is a symbolic link
-bool FZC::isSymLink(const std::string& path) {
-    struct stat st;
-    if (lstat(path.c_str(), &st) != 0) {
-        return false;
-    }
-    return (st.st_mode & S_IFMT) == S_IFLNK;
+// Checkpoint inside a directory listing or stat round: charges the token (so a deadline
+// trips mid-directory) and marks the scan alive; false once the scan should stop
+bool FZC::keepListing(CancellationToken* cancellationToken) {
+    if (m_progress) m_progress->touch();
+    if (!cancellationToken) return true;
+    cancellationToken->charge(0, 0);
+    return !cancellationToken->isCancelled();
 }
 
-// Get file size and directory flag; for symlink, return its own size (not target)
-std::pair<uint64_t, bool> FZC::getFileInfo(const std::string& path) {
-    struct stat st;
-    if (lstat(path.c_str(), &st) != 0) {
-        return {0, false};
-    }
-    if ((st.st_mode & S_IFMT) == S_IFLNK) {
-        // For symlink, return the size of the link itself
-        return {static_cast<uint64_t>(st.st_size), false};
-    }
-    bool isDir = false;
-    try {
-        isDir = fs::is_directory(path);
-    } catch (...) {
-        return {0, false};
-    }
-    uint64_t size = getFileSizeByFsType(path);
-    return {size, isDir};
+// True if the scan was cancelled and its partial results are not wanted
+static inline bool dropOnCancel(const CancellationToken* token) {
+    return token && token->isCancelled() && !token->keepPartialResults();
 }
 
+// Helper: check whether a stat mode describes an entry that can carry a size
+static inline bool isSizedEntry(mode_t mode) {
+    return S_ISREG(mode) || S_ISDIR(mode) || S_ISLNK(mode);
+}
+
+// Syscalls behind one allocated-size query (getattrlistat on macOS, none elsewhere)
+#ifdef __APPLE__
+static constexpr uint64_t SIZE_QUERY_SYSCALLS = 1;
+#else
+static constexpr uint64_t SIZE_QUERY_SYSCALLS = 0;
+#endif
+// openat, reading the entries and close
+static constexpr uint64_t DIRECTORY_SYSCALLS = 3;
+
+// Snapshot reused by the current scan, and stat records collected for the next one.
+// Records are appended per worker slot, so collecting them takes no lock.
+struct FZC::SnapshotState {
+    std::unique_ptr<ScanSnapshot> previous;
+    struct alignas(64) Slot {
+        std::vector<std::pair<NodeIndex, SnapshotStat>> records;
+    };
+    std::vector<Slot> slots;
+    std::atomic<uint64_t> reusedDirectories{0};
+};
+
 // Constructor: initialize firmlink map, data roots, and mount points
-FZC::FZC(bool useParallelProcessing, int maxThreads, bool useAllocatedSize, bool includeDirectorySize)
-    : m_maxThreads(maxThreads > 0 ? maxThreads : std::thread::hardware_concurrency()),
-      m_maxDepthForParallelism(8),
+FZC::FZC(bool useParallelProcessing, int maxThreads, bool useAllocatedSize, bool includeDirectorySize, bool useIoUring)
+    : m_useParallelProcessing(useParallelProcessing),
+      m_maxThreads(maxThreads > 0 ? maxThreads : std::thread::hardware_concurrency()),
       m_useAllocatedSize(useAllocatedSize),
-      m_includeDirectorySize(includeDirectorySize) {
+      m_includeDirectorySize(includeDirectorySize),
+      m_useIoUring(useIoUring),
+      m_hardLinks(std::make_unique<DevInoSet>()),
+      m_visitedDirs(std::make_unique<DevInoSet>()),
+      m_directoryFdBudget(directoryFdBudget()) {
     if (m_maxThreads < 1) m_maxThreads = 1;
-    m_mountPoints = getMountPoints();
+    // The calling thread helps while it waits, so the pool needs one thread less
+    if (m_useParallelProcessing && m_maxThreads > 1) {
+        m_pool = std::make_unique<WorkStealingPool>(m_maxThreads - 1);
+    }
+    m_mounts = std::make_unique<MountTable>(MountTable::load());
     // Firmlink mapping: key = installed system path, value = original data path (relative)
     m_firmlinkMap = {
         {"/AppleInternal", "AppleInternal"},
@@ -142,387 +310,974 @@ FZC::FZC(bool useParallelProcessing, int maxThreads, bool useAllocatedSize, bool
         "/System/Volumes/Data",
         // Add more data roots here if needed, e.g. "/Volumes/Macintosh HD"
     };
-}
-
-// Check if two paths are hard links to the same inode
-bool is_hard_link(const std::string& path1, const std::string& path2) {
-    struct stat st1, st2;
-    if (lstat(path1.c_str(), &st1) != 0 || lstat(path2.c_str(), &st2) != 0) {
-        perror("stat failed");
-        return false;
+    // Every directory is checked against these, so they are compiled once into a trie
+    m_firmlinkPrefixes = std::make_unique<PathPrefixTrie>();
+    for (const auto& root : m_dataRoots) {
+        for (const auto& kv : m_firmlinkMap) {
+            if (!kv.second.empty()) m_firmlinkPrefixes->insert(root + "/" + kv.second);
+        }
     }
-    return (st1.st_ino == st2.st_ino);
 }
 
-// Get all mount points on the system
-std::unordered_set<std::string> FZC::getMountPoints() {
-    std::unordered_set<std::string> mountPoints;
-    struct statfs* mntbuf = nullptr;
-    int mounts = getmntinfo(&mntbuf, MNT_WAIT);
-    if (mounts > 0 && mntbuf != nullptr) {
-        for (int i = 0; i < mounts; i++) {
-            const auto& fs = mntbuf[i];
-
-            if (fs.f_mntonname == nullptr) continue;
+FZC::~FZC() = default;
 
-            std::string mountPath = fs.f_mntonname;
-
-            if (strcmp(fs.f_mntonname, "/") != 0) {
-                bool fstype_not_apfs = true;
-                if (fs.f_fstypename != nullptr) {
-                    fstype_not_apfs = (strncmp(fs.f_fstypename, "apfs", 4) != 0);
-                }
-
-                if ((fs.f_flags & MNT_LOCAL) == 0 ||
-                    (fs.f_flags & MNT_REMOVABLE) ||
-                    fstype_not_apfs) {
-                    mountPoints.insert(mountPath);
-                }
+// Main entry: calculate folder sizes and timing
+FolderSizeResult FZC::calculateFolderSizes(const std::string& path, bool rootOnly, CancellationToken* cancellationToken) {
+    // Check for cancellation before starting
+    if (cancellationToken && cancellationToken->isCancelled()) {
+        return FolderSizeResult(nullptr, INVALID_NODE, 0.0);
+    }
+    
+    beginScan(path);
+    auto startTime = std::chrono::high_resolution_clock::now();
+    auto tree = std::make_shared<FileTree>();
+    m_tree = tree.get();
+    uint32_t snapshotFlags = (m_useAllocatedSize ? static_cast<uint32_t>(SNAPSHOT_ALLOCATED_SIZE) : 0u) |
+                             (m_includeDirectorySize ? static_cast<uint32_t>(SNAPSHOT_DIRECTORY_SIZE) : 0u);
+    if (!m_snapshotPath.empty()) {
+        m_snapshot = std::make_unique<SnapshotState>();
+        m_snapshot->previous = ScanSnapshot::open(m_snapshotPath, path, snapshotFlags);
+        m_snapshot->slots.resize(m_pool ? m_pool->threadCount() + 1 : 1);
+    }
+    NodeIndex rootNode = INVALID_NODE;
+    bool complete = true;
+    uint64_t reusedDirectories = 0;
+    try {
+        DirResult root = processRoot(path, rootOnly, cancellationToken);
+        enterPhase(ScanPhase::Finalize);
+        rootNode = root.node;
+        complete = root.complete;
+        
+        // Check for cancellation after processing; partial results keep the tree, flagged incomplete
+        if (cancellationToken && cancellationToken->isCancelled() && !cancellationToken->keepPartialResults()) {
+            m_tree = nullptr;
+            endScan();
+            return FolderSizeResult(nullptr, INVALID_NODE, 0.0);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error processing path: " << e.what() << std::endl;
+        rootNode = INVALID_NODE;
+    }
+    m_tree = nullptr;
+    ScanStats stats = collectStats();
+    // Only a complete scan of a directory with all its children linked is worth keeping
+    if (m_snapshot) {
+        reusedDirectories = m_snapshot->reusedDirectories.load();
+        if (complete && !rootOnly && rootNode != INVALID_NODE && tree->node(rootNode).isDirectory) {
+            std::vector<std::pair<NodeIndex, SnapshotStat>> records;
+            for (auto& slot : m_snapshot->slots) {
+                records.insert(records.end(), slot.records.begin(), slot.records.end());
+            }
+            // The old mapping is released first; the new file replaces it by rename
+            m_snapshot->previous.reset();
+            if (!ScanSnapshot::write(m_snapshotPath, snapshotFlags, *tree, rootNode, records)) {
+                std::cerr << "Error writing snapshot: " << m_snapshotPath << std::endl;
             }
         }
     }
-    return mountPoints;
-}
-
-// Check if a path is a mount point
-bool FZC::isMountPoint(const std::string& path) {
-    return m_mountPoints.find(path) != m_mountPoints.end();
+    MemoryReport memory = collectMemory();
+    endScan();
+    auto endTime = std::chrono::high_resolution_clock::now();
+    double elapsedTimeMs = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+    FolderSizeResult result(std::move(tree), rootNode, elapsedTimeMs);
+    result.hardLinkSavings = m_hardLinkSavings.load();
+    result.sparseFiles = m_sparseFiles.load();
+    result.isComplete = complete;
+    result.reusedDirectories = reusedDirectories;
+    result.stats = stats;
+    result.memory = memory;
+    if (cancellationToken) {
+        result.stopReason = cancellationToken->stopReason();
+        result.truncatedAt = cancellationToken->truncatedAt();
+    }
+    return result;
 }
 
-// Check if a path is a subpath of any mount point
-bool FZC::isSubPathOfMountPoint(const std::string& path) {
-    if (path.empty()) return false;
-    for (const auto& mount : m_mountPoints) {
-        if (path.length() > mount.length() && 
-            path.substr(0, mount.length()) == mount && 
-            path[mount.length()] == '/') {
-            return true;
-        }
+// Top-K entry: same walk as calculateFolderSizes, but nothing is kept except bounded heaps
+TopKResult FZC::calculateTopK(const std::string& path, size_t k, CancellationToken* cancellationToken) {
+    TopKResult result;
+    if (cancellationToken && cancellationToken->isCancelled()) {
+        return result;
     }
-    return false;
+    
+    beginScan(path);
+    auto startTime = std::chrono::high_resolution_clock::now();
+    TopKCollector collector(k, m_pool ? m_pool->threadCount() + 1 : 1);
+    m_topK = &collector;
+    try {
+        DirResult root = processRoot(path, false, cancellationToken);
+        result.totalSize = root.size;
+        result.isComplete = root.complete;
+    } catch (const std::exception& e) {
+        std::cerr << "Error processing path: " << e.what() << std::endl;
+    }
+    m_topK = nullptr;
+    endScan();
+    if (cancellationToken && cancellationToken->isCancelled() && !cancellationToken->keepPartialResults()) {
+        return TopKResult();
+    }
+    if (cancellationToken) {
+        result.stopReason = cancellationToken->stopReason();
+        result.truncatedAt = cancellationToken->truncatedAt();
+    }
+    result.largestFiles = collector.takeFiles();
+    result.largestDirectories = collector.takeDirectories();
+    result.hardLinkSavings = m_hardLinkSavings.load();
+    auto endTime = std::chrono::high_resolution_clock::now();
+    result.elapsedTimeMs = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+    return result;
 }
 
-// Main entry: calculate folder sizes and timing
-FolderSizeResult FZC::calculateFolderSizes(const std::string& path, bool rootOnly, CancellationToken* cancellationToken) {
-    // Check for cancellation before starting
+// Streaming entry: no tree and no collectors, only visitor callbacks
+ScanSummary FZC::scan(const std::string& path, ScanVisitor& visitor, CancellationToken* cancellationToken) {
+    ScanSummary summary;
     if (cancellationToken && cancellationToken->isCancelled()) {
-        return FolderSizeResult(nullptr, 0.0);
+        summary.cancelled = true;
+        return summary;
     }
     
-    m_entryFsType = getFsType(path);
+    beginScan(path);
     auto startTime = std::chrono::high_resolution_clock::now();
-    fs::path fsPath(path);
-    std::shared_ptr<FileNode> rootNode;
+    m_visitor = &visitor;
     try {
-        if (isSymLink(path)) {
-            rootNode = processFile(path, cancellationToken);
-        } else if (fs::is_regular_file(fsPath)) {
-            rootNode = processFile(path, cancellationToken);
-        } else if (fs::is_directory(fsPath)) {
-            rootNode = processDirectoryParallel(path, 0, rootOnly, cancellationToken);
-        }
-        
-        // Check for cancellation after processing
-        if (cancellationToken && cancellationToken->isCancelled()) {
-            return FolderSizeResult(nullptr, 0.0);
-        }
+        summary.totalSize = processRoot(path, false, cancellationToken).size;
     } catch (const std::exception& e) {
         std::cerr << "Error processing path: " << e.what() << std::endl;
-        rootNode = nullptr;
     }
+    m_visitor = nullptr;
+    endScan();
+    summary.cancelled = cancellationToken && cancellationToken->isCancelled();
+    if (cancellationToken) {
+        summary.stopReason = cancellationToken->stopReason();
+        summary.truncatedAt = cancellationToken->truncatedAt();
+    }
+    summary.hardLinkSavings = m_hardLinkSavings.load();
     auto endTime = std::chrono::high_resolution_clock::now();
-    double elapsedTimeMs = std::chrono::duration<double, std::milli>(endTime - startTime).count();
-    return FolderSizeResult(rootNode, elapsedTimeMs);
+    summary.elapsedTimeMs = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+    return summary;
 }
 
-// Decide if a directory should be skipped (firmlink, mount point, etc.)
-bool FZC::shouldSkipDirectory(const std::string& path) {
-    if (isCoveredByFirmlink(path)) return true;
-    if (m_processedPaths.empty()) {
-        m_entryPath = path;
+// Reset the per-scan state shared by all scan entry points
+void FZC::beginScan(const std::string& path) {
+    // Accounting starts first so the set-up below is attributed to the setup phase
+    if (m_memoryReport) {
+        m_memory = std::make_unique<MemoryAccounting>(m_pool ? m_pool->threadCount() + 1 : 1);
+        t_memoryBlock = m_memory->block(currentSlot());
+        enterPhase(ScanPhase::Setup);
     }
-    // More accurate mount point subpath skip logic
-    if (isMountPoint(path)) {
-        if (path == m_entryPath) return false;
-        if (startsWith(path, m_entryPath + "/")) return true;
-        return false;
+#ifdef FZC_ENABLE_STATS
+    m_stats.assign(m_pool ? m_pool->threadCount() + 1 : 1, StatsBlock());
+    bindStats();
+#endif
+    if (!m_tracePath.empty()) {
+        m_trace = std::make_unique<TraceRecorder>(m_pool ? m_pool->threadCount() + 1 : 1);
     }
-    if (isSubPathOfMountPoint(path)) {
-        // Compare device id: if same device as entry, do not skip
-        dev_t entryDev = getDeviceId(m_entryPath);
-        dev_t pathDev = getDeviceId(path);
-        if (entryDev != 0 && pathDev != 0 && entryDev == pathDev) {
-            return false;
+    // The root's device decides every filesystem crossing of the scan
+    m_entryDev = getDeviceId(path);
+    m_entryFsType = getFsType(path);
+    if (m_entryFsType.empty()) {
+        if (const MountEntry* mount = m_mounts->findByDevice(m_entryDev)) m_entryFsType = mount->fsType;
+    }
+    m_entryPath = path;
+    m_hardLinks->clear();
+    m_visitedDirs->clear();
+    m_hardLinkSavings.store(0);
+    m_sparseFiles.store(0);
+    if (m_progress) m_progress->start();
+}
+
+void FZC::endScan() {
+#ifdef FZC_ENABLE_STATS
+    t_statsBlock = nullptr;
+#endif
+    if (m_memory) {
+        t_memoryBlock = nullptr;
+        m_memory.reset();
+    }
+    m_snapshot.reset();
+    if (m_trace) {
+        if (!m_trace->writeChromeTrace(m_tracePath)) {
+            std::cerr << "Error writing trace: " << m_tracePath << std::endl;
         }
-        if (startsWith(path, m_entryPath + "/") && isMountPoint(m_entryPath)) return false;
-        return true;
+        m_trace.reset();
     }
-    return false;
+    if (m_progress) m_progress->finish();
+}
+
+// Point the calling thread's instrumentation at its slot of the current scan
+void FZC::bindStats() {
+#ifdef FZC_ENABLE_STATS
+    t_statsBlock = m_stats.empty() ? nullptr : &m_stats[currentSlot()];
+#endif
+}
+
+// Span on the calling thread's timeline lane; inert unless a traced scan is running
+TraceSpan FZC::traceSpan(const char* name) const {
+    return TraceSpan(m_trace.get(), m_trace ? currentSlot() : 0, name);
+}
+
+// Allocation counters of the current scan; empty unless memory reporting is on
+MemoryReport FZC::collectMemory() const {
+    return m_memory ? m_memory->collect() : MemoryReport();
 }
 
-// Check if the current process has read access to the path
-bool FZC::hasAccessPermission(const std::string& path) {
-    int ret = access(path.c_str(), R_OK);
-    if (ret != 0) {
-        std::cerr << "[access error] " << path << " : " << strerror(errno) << std::endl;
+// Sum the per-slot instrumentation blocks of the current scan
+ScanStats FZC::collectStats() const {
+    ScanStats stats;
+#ifdef FZC_ENABLE_STATS
+    stats.enabled = true;
+    for (const StatsBlock& block : m_stats) {
+        for (int kind = 0; kind < STAT_KIND_COUNT; ++kind) {
+            stats.count[kind] += block.count[kind];
+            stats.nanoseconds[kind] += block.nanoseconds[kind];
+        }
     }
-    return ret == 0;
+#endif
+    return stats;
+}
+
+const char* ScanStats::name(StatKind kind) {
+    static const char* names[STAT_KIND_COUNT] = {
+        "lstat", "stat", "fstatat", "statx", "getattrlist", "statfs",
+        "openat", "readDirectory", "close", "lockWait", "taskSpawn", "childSort"};
+    int index = static_cast<int>(kind);
+    return index >= 0 && index < STAT_KIND_COUNT ? names[index] : "unknown";
+}
+
+// Stat the scan root once and dispatch to the directory or file path
+FZC::DirResult FZC::processRoot(const std::string& path, bool rootOnly, CancellationToken* cancellationToken) {
+    struct stat st;
+    int status;
+    {
+        FZC_STAT_SCOPE(StatKind::Lstat);
+        status = lstat(path.c_str(), &st);
+    }
+    if (status != 0) {
+        noteError();
+        return DirResult();
+    }
+    if (S_ISDIR(st.st_mode)) {
+        if (m_progress) m_progress->addBatch(1, 0, 1);
+        NodeIndex cached = m_snapshot && m_snapshot->previous ? ScanSnapshot::ROOT : INVALID_NODE;
+        return processDirectoryParallel(AT_FDCWD, path, path, st, 0, rootOnly, cancellationToken, cached);
+    }
+    if (S_ISLNK(st.st_mode) || S_ISREG(st.st_mode)) {
+        return processFile(path, st, cancellationToken);
+    }
+    return DirResult();
+}
+
+// Slot of the calling thread in per-thread collectors (pool workers first, then the caller)
+int FZC::currentSlot() const {
+    if (!m_pool) return 0;
+    int index = m_pool->currentWorkerIndex();
+    return index >= 0 ? index : m_pool->threadCount();
+}
+
+// Add a non-directory entry to whatever the current scan collects
+NodeIndex FZC::recordFile(ChildList& children, const std::string& dirPath, const std::string& name, uint64_t size, bool sparse) {
+    NodeIndex node = INVALID_NODE;
+    if (sparse) m_sparseFiles.fetch_add(1, std::memory_order_relaxed);
+    if (m_tree) {
+        node = m_tree->addNode(name, size, false);
+        m_tree->node(node).isSparse = sparse;
+        children.push_back(node);
+    }
+    if (m_topK && size > 0) m_topK->offerFile(currentSlot(), dirPath, name, size);
+    if (m_visitor) m_visitor->onFile(dirPath, name, size);
+    return node;
+}
+
+// Stat identity of a tree node, kept for the snapshot written after the scan
+void FZC::recordSnapshotStat(NodeIndex node, const SnapshotStat& record) {
+    if (node == INVALID_NODE) return;
+    m_snapshot->slots[currentSlot()].records.emplace_back(node, record);
+}
+
+// List an unchanged directory from the previous snapshot instead of the filesystem.
+// Files are recorded right away (hard links deduped as in a fresh scan); subdirectories
+// are returned as entries to stat and walk. Returns false if the snapshot does not apply.
+bool FZC::reuseSnapshot(NodeIndex cached, const struct stat& st, const std::string& dirPath, uint64_t& dirTotal,
+                        ChildList& children, DirEntryList& entries, CancellationToken* cancellationToken) {
+    const ScanSnapshot* previous = m_snapshot ? m_snapshot->previous.get() : nullptr;
+    if (!previous || cached == INVALID_NODE) return false;
+    const SnapshotNode& directory = previous->node(cached);
+    const SnapshotStat* record = previous->record(directory);
+    if (!directory.isDirectory || !directory.isComplete || !record || !record->matches(st)) return false;
+
+    uint64_t fileCount = 0;
+    uint64_t bytes = 0;
+    for (uint32_t i = directory.firstChild; i < directory.firstChild + directory.childCount; ++i) {
+        const SnapshotNode& child = previous->node(i);
+        std::string name(previous->name(child));
+        if (child.isDirectory) {
+            entries.push_back(DirEntry{std::move(name), DT_DIR, {}, false});
+            continue;
+        }
+        ++fileCount;
+        uint64_t size = child.size;
+        const SnapshotStat* link = previous->record(child);
+        if (link) {
+            size = link->fullSize;
+            if (size > 0 && !m_hardLinks->insert(static_cast<dev_t>(link->dev), static_cast<ino_t>(link->ino))) {
+                m_hardLinkSavings.fetch_add(size);
+                size = 0;
+            }
+        }
+        dirTotal += size;
+        bytes += size;
+        NodeIndex node = recordFile(children, dirPath, name, size, child.isSparse != 0);
+        if (link) recordSnapshotStat(node, *link);
+    }
+    m_snapshot->reusedDirectories.fetch_add(1, std::memory_order_relaxed);
+    if (m_progress) m_progress->addBatch(fileCount, bytes, 0);
+    if (cancellationToken) cancellationToken->charge(fileCount, 0);
+    return true;
+}
+
+// Report a finished directory to the streaming consumers of the scan
+void FZC::leaveDirectory(const std::string& path, int depth, const DirResult& result) {
+    // The scan root is reported as the total, not as one of the largest directories
+    if (m_topK && depth > 0) m_topK->offerDirectory(currentSlot(), path, result.size);
+    if (m_visitor) m_visitor->onLeave(path, result.size);
+}
+
+// Decide if a directory should be skipped (firmlink, another filesystem, etc.)
+// Filesystem crossings are decided from the directory's own st_dev, with no further syscall
+bool FZC::shouldSkipDirectory(const std::string& path, const struct stat& st) {
+    if (isCoveredByFirmlink(path)) return true;
+    // Everything on the scan root's filesystem is walked, including the root of a skipped mount
+    if (st.st_dev == m_entryDev) return false;
+    if (m_oneFileSystem) return true;
+    return m_mounts->isSkippedDevice(st.st_dev);
+}
+
+// Helper: report a directory that could not be opened or listed. Only the failing
+// openat or read decides this: mode bits miss ACLs, capabilities and network filesystems.
+static void logDirectoryError(const std::string& path, int error) {
+    const char* kind = (error == EACCES || error == EPERM) ? "[access error] " : "[directory error] ";
+    std::cerr << kind << path << " : " << strerror(error) << std::endl;
 }
 
 // Recursively process a directory in parallel, collecting size and children
-std::shared_ptr<FileNode> FZC::processDirectoryParallel(const std::string& path, int depth, bool rootOnly, CancellationToken* cancellationToken) {
+// parentFd/name locate the directory for openat; path is only used for display and skip rules
+FZC::DirResult FZC::processDirectoryParallel(int parentFd, const std::string& name, const std::string& path, const struct stat& st, int depth, bool rootOnly, CancellationToken* cancellationToken, NodeIndex cached) {
+    // Counts the directory as completed for progress reporting, however this returns
+    struct CompletionGuard {
+        ScanProgress* progress;
+        ~CompletionGuard() { if (progress) progress->m_directoriesCompleted.fetch_add(1, std::memory_order_relaxed); }
+    } completion{m_progress};
+#ifdef FZC_ENABLE_STATS
+    // Tasks can land on any worker; record into the slot of the thread running this one
+    bindStats();
+#endif
+    MemoryScope memoryScope(m_memory.get(), m_memory ? currentSlot() : 0, ScanPhase::Record);
+    DirResult result;
+    // With partial results, a cancelled directory keeps what was aggregated so far
+    // and is flagged incomplete; otherwise it is dropped from the result. The mode
+    // is read at each check, since a deadline or budget trip switches it on.
     // Check for cancellation at the beginning
-    if (cancellationToken && cancellationToken->isCancelled()) {
-        return nullptr;
+    if (dropOnCancel(cancellationToken)) {
+        return result;
     }
+    TraceSpan directorySpan = traceSpan("directory");
     
     try {
-        fs::path dirPath(path);
-        std::string workPath = dirPath.string();
+        const std::string& workPath = path;
+        // Without a parent fd (the root, or past the fd budget) the directory is reached by path
+        const std::string& openName = parentFd == AT_FDCWD ? path : name;
         uint64_t dirSize = 0;
         if (m_includeDirectorySize) {
-            dirSize = getFileSizeByFsType(workPath);
+            dirSize = getFileSizeByFsType(parentFd, openName, st);
         }
-        auto node = std::make_shared<FileNode>(workPath, workPath, dirSize, true);
-        if (!hasAccessPermission(workPath)) return node;
-        if (isSymLink(path)) return processFile(path, cancellationToken);
-        
-        fs::path parentPath = dirPath.parent_path();
-        if (parentPath != "/" && dirPath.has_parent_path()) {
-            std::string rootSubPath = "/" + dirPath.filename().string();
-            if (fs::exists(rootSubPath) && is_hard_link(workPath, rootSubPath)) return nullptr;
+        bool skip = shouldSkipDirectory(path, st);
+        // A directory reached twice (bind mounts, firmlinks, directory hard links) is
+        // walked once: identity is (st_dev, st_ino), checked in a sharded set
+        if (!skip && !m_visitedDirs->insert(st.st_dev, st.st_ino)) return result;
+        result.counted = true;
+        result.size = dirSize;
+        // The root keeps the path it was scanned with; every other node stores its bare name
+        if (m_tree) result.node = m_tree->addNode(name, dirSize, true);
+        if (m_progress && dirSize > 0) m_progress->addBatch(0, dirSize, 0);
+        if (m_visitor) m_visitor->onEnter(workPath);
+        // A directory reached after cancellation stays as an empty, incomplete placeholder
+        if (cancellationToken && cancellationToken->isCancelled()) {
+            result.complete = false;
+            if (m_tree) m_tree->node(result.node).isComplete = false;
+            leaveDirectory(workPath, depth, result);
+            return result;
         }
-        if (!fs::exists(dirPath)) return node;
-        if (shouldSkipDirectory(path)) return node;
-        {
-            std::lock_guard<std::mutex> lock(m_pathMapMutex);
-            if (m_processedPaths.find(workPath) != m_processedPaths.end()) return nullptr;
-            m_processedPaths.insert(workPath);
+        if (skip) {
+            leaveDirectory(workPath, depth, result);
+            return result;
         }
+        int openedFd;
+        int listError = 0;
         {
-            std::lock_guard<std::mutex> lock(m_cacheMutex);
-            m_pathMap[workPath] = workPath;
+            FZC_STAT_SCOPE(StatKind::Openat);
+            openedFd = openat(parentFd, openName.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+            if (openedFd < 0) listError = errno;
         }
-        std::vector<fs::directory_entry> batch;
+        ScopedFd dirFd(openedFd, &m_openDirectories);
+        // openat, the directory read and close count against a syscall budget
+        if (cancellationToken) cancellationToken->charge(0, DIRECTORY_SYSCALLS);
+        enterPhase(ScanPhase::Enumerate);
+        DirEntryList entries;
+        ChildList children;
+        // A directory unchanged since the snapshot is not listed: its files come from
+        // the snapshot and only its subdirectories are stat'ed and walked again
+        bool reused = dirFd.get() >= 0 && reuseSnapshot(cached, st, workPath, result.size, children, entries, cancellationToken);
+        bool listed = reused;
+        auto keepGoing = [this, cancellationToken]() { return keepListing(cancellationToken); };
+        if (dirFd.get() >= 0 && !reused) {
+            FZC_STAT_SCOPE(StatKind::ReadDirectory);
+            TraceSpan span = traceSpan("enumerate");
+            listed = readDirectory(dirFd.get(), entries, keepGoing);
+            if (!listed) listError = errno;
+            span.setArg(entries.size());
+        }
+        directorySpan.setArg(entries.size());
+        // A directory that could not be opened or read in full keeps its node, flagged incomplete
+        if (!listed) {
+            logDirectoryError(workPath, listError);
+            noteError();
+            result.complete = false;
+            if (m_tree) m_tree->node(result.node).isComplete = false;
+            leaveDirectory(workPath, depth, result);
+            return result;
+        }
+#ifdef __linux__
+        // Batch all entry stats through io_uring; anything it misses is stat'ed synchronously below
+        if (m_useIoUring) {
+            ThreadStatEngine& uring = threadStatEngine();
+            if (uring.engine) {
+                TraceSpan span = traceSpan("statx");
+                span.setArg(entries.size());
+                // Entries left without a stat fall back to fstatat in processBatch
+                if (!uring.engine->statEntries(dirFd.get(), entries, keepGoing)) uring.discard();
+            }
+        }
+#endif
+        // Listing and stat'ing stop early on cancellation; what was gathered is partial
+        if (cancellationToken && cancellationToken->isCancelled()) {
+            if (!cancellationToken->keepPartialResults()) return DirResult();
+            result.complete = false;
+        }
+        // Ancestors keep their fds while descendants are walked; past the budget this
+        // directory lets go of its fd now, and its entries are stat'ed and opened by path
+        if (m_openDirectories.load(std::memory_order_relaxed) > m_directoryFdBudget) dirFd.reset();
+        int entriesFd = dirFd.get() >= 0 ? dirFd.get() : AT_FDCWD;
+        enterPhase(ScanPhase::Record);
+        bool clean = true;
+        DirEntryList batch;
         batch.reserve(BATCH_SIZE);
-        std::vector<std::future<std::shared_ptr<FileNode>>> futures;
+        // Subdirectory results land in stable deque slots filled by pool tasks;
+        // the group is destroyed (and waited on) before dirFd is closed
+        std::deque<DirResult> childResults;
+        std::unique_ptr<TaskGroup> group;
+        if (m_pool) group = std::make_unique<TaskGroup>(*m_pool);
         try {
-            for (const auto& entry : fs::directory_iterator(dirPath, fs::directory_options::skip_permission_denied)) {
+            for (auto& entry : entries) {
                 // Check for cancellation during iteration
                 if (cancellationToken && cancellationToken->isCancelled()) {
-                    return nullptr;
+                    if (!cancellationToken->keepPartialResults()) return DirResult();
+                    result.complete = false;
+                    break;
                 }
                 
-                try {
-                    batch.push_back(entry);
-                    if (batch.size() >= BATCH_SIZE) {
-                        processBatch(batch, node, depth, futures, cancellationToken);
-                        // Check for cancellation after batch processing
-                        if (cancellationToken && cancellationToken->isCancelled()) {
-                            return nullptr;
-                        }
+                batch.push_back(std::move(entry));
+                if (batch.size() >= BATCH_SIZE) {
+                    if (!processBatch(entriesFd, workPath, batch, result.size, children, depth, group.get(), childResults, cached, clean, cancellationToken)) {
+                        result.complete = false;
+                    }
+                    // Check for cancellation after batch processing
+                    if (cancellationToken && cancellationToken->isCancelled()) {
+                        if (!cancellationToken->keepPartialResults()) return DirResult();
+                        result.complete = false;
+                        break;
                     }
-                } catch (const fs::filesystem_error&) {
-                    continue;
                 }
             }
-            if (!batch.empty()) {
-                processBatch(batch, node, depth, futures, cancellationToken);
+            if (!batch.empty() && result.complete) {
+                if (!processBatch(entriesFd, workPath, batch, result.size, children, depth, group.get(), childResults, cached, clean, cancellationToken)) {
+                    result.complete = false;
+                }
                 // Check for cancellation after final batch
-                if (cancellationToken && cancellationToken->isCancelled()) {
-                    return nullptr;
+                if (dropOnCancel(cancellationToken)) {
+                    return DirResult();
                 }
             }
-            for (auto& future : futures) {
-                // Check for cancellation before waiting for futures
-                if (cancellationToken && cancellationToken->isCancelled()) {
-                    return nullptr;
-                }
-                
+            if (group) {
+                // The waiting thread runs other tasks meanwhile; their spans nest inside this one
+                TraceSpan span = traceSpan("wait");
                 try {
-                    if (auto childNode = future.get()) {
-                        node->size += childNode->size;
-                        node->children.push_back(childNode);
-                    }
-                } catch (const std::exception&) {}
+                    group->wait();
+                } catch (const std::exception& e) {
+                    // A subdirectory task failed: its slot holds no result, so this total is short
+                    std::cerr << "Error processing subdirectory of " << workPath << ": " << e.what() << std::endl;
+                    result.complete = false;
+                }
             }
-            if (!node->children.empty()) {
-                std::sort(node->children.begin(), node->children.end(),
-                          [](const auto& a, const auto& b) {
-                              if (a->size != b->size) return a->size > b->size;
-                              return a->path < b->path;
-                          });
+            // Check for cancellation after waiting for subdirectories
+            if (dropOnCancel(cancellationToken)) {
+                return DirResult();
             }
-            if (rootOnly) node->children.clear();
+            enterPhase(ScanPhase::Link);
+            // Only a directory listed in full, with every entry recorded, can be taken from
+            // the snapshot next time. Skipped, cancelled and failed directories get no stat
+            // record, so a later scan walks them again under its own rules.
+            if (m_snapshot && result.complete && clean) recordSnapshotStat(result.node, SnapshotStat::fromStat(st));
+            for (const DirResult& child : childResults) {
+                if (!child.complete) result.complete = false;
+                if (child.counted) {
+                    result.size += child.size;
+                    if (child.node != INVALID_NODE) children.push_back(child.node);
+                }
+            }
+            if (m_tree) {
+                m_tree->node(result.node).size = result.size;
+                m_tree->node(result.node).isComplete = result.complete;
+                if (rootOnly) children.clear();
+                if (!children.empty()) {
+                    FZC_STAT_SCOPE(StatKind::ChildSort);
+                    TraceSpan span = traceSpan("sort");
+                    span.setArg(children.size());
+                    const FileTree& tree = *m_tree;
+                    std::sort(children.begin(), children.end(),
+                              [&tree](NodeIndex a, NodeIndex b) {
+                                  const FileNode& na = tree.node(a);
+                                  const FileNode& nb = tree.node(b);
+                                  if (na.size != nb.size) return na.size > nb.size;
+                                  return tree.nameView(na) < tree.nameView(nb);
+                              });
+                }
+                m_tree->setChildren(result.node, children);
+            }
+            leaveDirectory(workPath, depth, result);
         } catch (const std::exception& e) {
             std::cerr << "Error processing directory: " << e.what() << std::endl;
-            return node;
+            if (m_tree) m_tree->node(result.node).size = result.size;
+            leaveDirectory(workPath, depth, result);
+            return result;
         }
-        return node;
+        return result;
     } catch (const std::exception& e) {
         std::cerr << "Error processing directory: " << e.what() << std::endl;
-        return std::make_shared<FileNode>(path, path, 0, true);
+        // Keep the directory in the structure, without a size
+        if (m_tree && result.node != INVALID_NODE) m_tree->node(result.node).size = 0;
+        result.size = 0;
+        return result;
     }
 }
 
 // Process a batch of directory entries, possibly in parallel
-void FZC::processBatch(
-    std::vector<fs::directory_entry>& batch,
-    std::shared_ptr<FileNode>& node,
+bool FZC::processBatch(
+    int dirFd,
+    const std::string& dirPath,
+    DirEntryList& batch,
+    uint64_t& dirTotal,
+    ChildList& children,
     int depth,
-    std::vector<std::future<std::shared_ptr<FileNode>>>& futures,
+    TaskGroup* group,
+    std::deque<DirResult>& childResults,
+    NodeIndex cached,
+    bool& clean,
     CancellationToken* cancellationToken) {
-    for (const auto& entry : batch) {
+    // Progress is published once per batch, before any subdirectory is walked,
+    // so a fast child never completes before it is counted as found
+    TraceSpan span = traceSpan("batch");
+    span.setArg(batch.size());
+    uint64_t batchBytes = 0;
+    uint64_t batchSyscalls = 0;
+    bool complete = true;
+    struct Subdirectory {
+        std::string name;
+        std::string workPath;
+        struct stat st;
+        NodeIndex cached;
+    };
+    std::vector<Subdirectory> subdirectories;
+    for (auto& entry : batch) {
         // Check for cancellation during batch processing
         if (cancellationToken && cancellationToken->isCancelled()) {
+            complete = false;
             break;
         }
         
         try {
-            std::string workPath = entry.path().string();
-            if (!hasAccessPermission(workPath)) {
-                auto unauthorizedNode = std::make_shared<FileNode>(workPath, workPath, 0, false);
-                node->children.push_back(unauthorizedNode);
+            // FIFOs, sockets and devices have no size worth counting; skip them without a stat
+            if (entry.type != DT_UNKNOWN && entry.type != DT_REG &&
+                entry.type != DT_DIR && entry.type != DT_LNK) {
                 continue;
             }
-            if (isSymLink(workPath)) {
-                auto [size, _] = getFileInfo(workPath);
-                auto symlinkNode = std::make_shared<FileNode>(workPath, workPath, size, false);
-                node->size += symlinkNode->size;
-                node->children.push_back(symlinkNode);
-                continue;
-            }
-            auto [size, isDir] = getFileInfo(workPath);
-            if (isDir && depth < m_maxDepthForParallelism && m_activeThreads < m_maxThreads) {
-                std::lock_guard<std::mutex> lock(m_threadMutex);
-                if (m_activeThreads < m_maxThreads) {
-                    m_activeThreads++;
-                    futures.push_back(std::async(std::launch::async,
-                                                 [this, workPath, depth, cancellationToken]() {
-                                                     auto result = processDirectoryParallel(workPath, depth + 1, false, cancellationToken);
-                                                     m_activeThreads--;
-                                                     return result;
-                                                 }));
+            // Entries of a directory closed early are resolved from the current directory by path
+            std::string entryPath = dirFd == AT_FDCWD ? joinPath(dirPath, entry.name) : std::string();
+            const std::string& entryName = dirFd == AT_FDCWD ? entryPath : entry.name;
+            // Stat each entry exactly once; every later decision reads from this result
+            struct stat st;
+            // A stat batched through io_uring still costs the filesystem one metadata lookup
+            ++batchSyscalls;
+            if (entry.hasStat) {
+                st = entry.st;
+            } else {
+                int status;
+                {
+                    FZC_STAT_SCOPE(StatKind::Fstatat);
+                    status = fstatat(dirFd, entryName.c_str(), &st, AT_SYMLINK_NOFOLLOW);
+                }
+                if (status != 0) {
+                    noteError();
+                    clean = false;
                     continue;
                 }
             }
+            // A stat needs no read permission on the entry: files are always counted, and an
+            // unreadable directory is reported when opening it fails
+            if (!isSizedEntry(st.st_mode)) continue;
+            if (S_ISLNK(st.st_mode)) {
+                // For symlink, count the size of the link itself
+                uint64_t size = getLinkSize(st);
+                dirTotal += size;
+                batchBytes += size;
+                recordFile(children, dirPath, entry.name, size);
+                continue;
+            }
+            bool isDir = S_ISDIR(st.st_mode);
             if (isDir) {
-                auto childNode = processDirectoryParallel(workPath, depth + 1, false, cancellationToken);
-                if (childNode) {
-                    node->size += childNode->size;
-                    node->children.push_back(childNode);
+                // Directories still need their full path for the firmlink and mount point rules
+                std::string workPath = joinPath(dirPath, entry.name);
+                NodeIndex cachedChild = INVALID_NODE;
+                if (m_snapshot && m_snapshot->previous && cached != INVALID_NODE) {
+                    cachedChild = m_snapshot->previous->findChild(cached, entry.name);
                 }
-            } else if (size > 0) {
-                auto fileNode = std::make_shared<FileNode>(workPath, workPath, size, false);
-                node->size += size;
-                node->children.push_back(fileNode);
+                subdirectories.push_back({std::move(entry.name), std::move(workPath), st, cachedChild});
+                continue;
+            }
+            bool sparse = false;
+            uint64_t size = getFileSizeByFsType(dirFd, entryName, st, &sparse);
+            if (m_useAllocatedSize) batchSyscalls += SIZE_QUERY_SYSCALLS;
+            // Count hard-linked data once: later links to a seen (dev, ino) keep a node with size 0
+            if (st.st_nlink > 1 && size > 0 && !m_hardLinks->insert(st.st_dev, st.st_ino)) {
+                m_hardLinkSavings.fetch_add(size);
+                NodeIndex node = recordFile(children, dirPath, entry.name, 0);
+                if (m_snapshot) recordSnapshotStat(node, SnapshotStat::fromStat(st, size));
+                continue;
+            }
+            // Fully sparse files allocate nothing but are still listed, with their flag
+            if (size > 0 || sparse) {
+                dirTotal += size;
+                batchBytes += size;
+                NodeIndex node = recordFile(children, dirPath, entry.name, size, sparse);
+                // Hard-linked files keep their identity so a later scan can dedupe them again
+                if (m_snapshot && st.st_nlink > 1) recordSnapshotStat(node, SnapshotStat::fromStat(st, size));
             }
         } catch (const std::exception&) {
+            noteError();
+            clean = false;
             continue;
         }
     }
+    if (m_progress) m_progress->addBatch(batch.size(), batchBytes, subdirectories.size());
+    // Deadlines and budgets are checked here, once per batch
+    if (cancellationToken) cancellationToken->charge(batch.size(), batchSyscalls);
     batch.clear();
+    for (auto& subdirectory : subdirectories) {
+        try {
+            if (group) {
+                // Every subdirectory becomes a stealable task, whatever its depth
+                auto* slot = &childResults.emplace_back();
+                FZC_STAT_SCOPE(StatKind::TaskSpawn);
+                group->run([this, dirFd, subdirectory = std::move(subdirectory), depth, slot, cancellationToken]() {
+                    *slot = processDirectoryParallel(dirFd, subdirectory.name, subdirectory.workPath, subdirectory.st,
+                                                     depth + 1, false, cancellationToken, subdirectory.cached);
+                });
+                continue;
+            }
+            DirResult child = processDirectoryParallel(dirFd, subdirectory.name, subdirectory.workPath, subdirectory.st,
+                                                       depth + 1, false, cancellationToken, subdirectory.cached);
+            if (!child.complete) complete = false;
+            if (child.counted) {
+                dirTotal += child.size;
+                if (child.node != INVALID_NODE) children.push_back(child.node);
+            }
+        } catch (const std::exception&) {
+            noteError();
+            clean = false;
+            complete = false;
+        }
+    }
+    return complete;
 }
 
 // Process a single file or symlink; always returns a node for structure
-std::shared_ptr<FileNode> FZC::processFile(const std::string& path, CancellationToken* cancellationToken) {
+FZC::DirResult FZC::processFile(const std::string& path, const struct stat& st, CancellationToken* cancellationToken) {
+    DirResult result;
     // Check for cancellation
     if (cancellationToken && cancellationToken->isCancelled()) {
-        return nullptr;
+        return result;
     }
     
-    try {
-        auto [size, isDir] = getFileInfo(path);
-        if (size == 0 && !isDir) {
-            // Return node with size=0 for error or unreadable file, to keep structure
-            std::string workPath = fs::path(path).string();
-            {
-                std::lock_guard<std::mutex> lock(m_pathMapMutex);
-                m_pathMap[workPath] = workPath;
-            }
-            return std::make_shared<FileNode>(workPath, workPath, 0, false);
-        }
-        std::string workPath = fs::path(path).string();
-        {
-            std::lock_guard<std::mutex> lock(m_pathMapMutex);
-            m_pathMap[workPath] = workPath;
-        }
-        return std::make_shared<FileNode>(workPath, workPath, size, isDir);
-    } catch (const std::exception&) {
-        // Return node with size=0 for error, to keep structure
-        std::string workPath = fs::path(path).string();
-        {
-            std::lock_guard<std::mutex> lock(m_pathMapMutex);
-            m_pathMap[workPath] = workPath;
+    std::string workPath = fs::path(path).string();
+    // For symlink, return the size of the link itself (not target)
+    result.counted = true;
+    bool sparse = false;
+    result.size = S_ISLNK(st.st_mode) ? getLinkSize(st) : getFileSizeByFsType(AT_FDCWD, workPath, st, &sparse);
+    if (sparse) m_sparseFiles.fetch_add(1, std::memory_order_relaxed);
+    // Unreadable or empty files keep a node with size=0, to keep structure
+    if (m_tree) {
+        result.node = m_tree->addNode(workPath, result.size, false);
+        m_tree->node(result.node).isSparse = sparse;
+    }
+    if (m_progress) m_progress->addBatch(1, result.size, 0);
+    if (m_topK || m_visitor) {
+        fs::path fsPath(workPath);
+        if (m_topK && result.size > 0) {
+            m_topK->offerFile(currentSlot(), fsPath.parent_path().string(), fsPath.filename().string(), result.size);
         }
-        return std::make_shared<FileNode>(workPath, workPath, 0, false);
+        if (m_visitor) m_visitor->onFile(fsPath.parent_path().string(), fsPath.filename().string(), result.size);
     }
+    return result;
 }
 
-// Helper: get allocated size or fallback to st_size if not APFS/HFS
-uint64_t FZC::getFileSizeByFsType(const std::string& path) {
-    struct stat st;
-    if (lstat(path.c_str(), &st) != 0) return 0;
-    if (m_useAllocatedSize) {
-        uint64_t sz = getAllocatedSize(path);
-        if (sz > 0) return sz;
-        if (m_entryFsType == "apfs" || m_entryFsType == "hfs") {
-            return sz;
-        }
+// Helper: get allocated size or fallback to st_size. On Linux the allocation is
+// st_blocks (512-byte units, as du counts it) from the stat already made, so it
+// costs no syscall. sparse (if given) is set for regular files allocated below
+// their apparent size: holes, or compression on btrfs/zfs.
+uint64_t FZC::getFileSizeByFsType(int dirfd, const std::string& name, const struct stat& st, bool* sparse) {
+    uint64_t apparent = static_cast<uint64_t>(st.st_size);
+    uint64_t allocated = static_cast<uint64_t>(st.st_blocks) * 512;
+    if (!m_useAllocatedSize) {
+        if (sparse) *sparse = S_ISREG(st.st_mode) && allocated < apparent;
+        return apparent;
+    }
+#ifdef __APPLE__
+    // APFS clones and compression are only visible to getattrlist; its size is authoritative there
+    uint64_t sz = 0;
+    if (getAllocatedSize(dirfd, name, sz)) {
+        allocated = sz;
+    } else {
+        noteError();
+    }
+    if (sparse) *sparse = S_ISREG(st.st_mode) && allocated < apparent;
+    if (sz > 0) return sz;
+    if (m_entryFsType == "apfs" || m_entryFsType == "hfs") {
+        return sz;
     }
+    return apparent;
+#else
+    (void)dirfd;
+    (void)name;
+    if (sparse) *sparse = S_ISREG(st.st_mode) && allocated < apparent;
+    return allocated;
+#endif
+}
+
+// Helper: size of a symlink itself. Linux counts its blocks as du does (0 for
+// links stored in the inode); elsewhere, and for apparent sizes, its length.
+uint64_t FZC::getLinkSize(const struct stat& st) const {
+#ifndef __APPLE__
+    if (m_useAllocatedSize) return static_cast<uint64_t>(st.st_blocks) * 512;
+#endif
     return static_cast<uint64_t>(st.st_size);
 }
 
-// Check if a path is covered by a firmlink (skip if so)
-bool FZC::isCoveredByFirmlink(const std::string& path) {
-    std::string normPath = normalizePath(path);
-    for (const auto& root : m_dataRoots) {
-        std::string normRoot = normalizePath(root);
-        if (normPath == normRoot || !startsWith(normPath, normRoot + "/")) continue;
-        // Get relative path with leading slash
-        std::string rel = normPath.substr(normRoot.length());
-        if (rel.empty()) rel = "/";
-        if (rel[0] != '/') rel = "/" + rel;
-        for (const auto& kv : m_firmlinkMap) {
-            std::string value = kv.second;
-            if (value.empty() || value[0] != '/') value = "/" + value;
-            if (rel == value || startsWith(rel, value + "/")) {
-                // Only log firmlink skip for debugging
-                // std::cout << "[firmlink skip] " << path << std::endl;
-                return true;
-            }
+// Check if a path is covered by a firmlink (skip if so): at or below <data root>/<firmlink target>
+bool FZC::isCoveredByFirmlink(const std::string& path) const {
+    return m_firmlinkPrefixes->covers(path);
+}
+
+// Handle behind FileNodePtr: keeps the tree alive after releaseResult, and
+// caches the child index list (so getChildNode is O(1) after the first call)
+// and the full path returned by getNodePath
+struct FileNodeHandle {
+    FileNodeHandle(std::shared_ptr<FileTree> tree, NodeIndex index) : tree(std::move(tree)), index(index) {}
+
+    std::shared_ptr<FileTree> tree;
+    NodeIndex index;
+    std::vector<NodeIndex> children;
+    bool childrenLoaded = false;
+    std::string path;
+
+    const FileNode& node() const { return tree->node(index); }
+};
+
+// Settings of one C API scan, filled by the setScan* functions
+struct ScanRequest {
+    std::string rootPath;
+    bool rootOnly = false;
+    bool useAllocatedSize = true;
+    bool includeDirectorySize = true;
+    int maxThreads = 0;
+    bool useIoUring = false;
+    bool oneFileSystem = false;
+    CancellationToken* cancellationToken = nullptr;
+    ScanProgress* progress = nullptr;
+    std::string snapshotPath;
+    std::string tracePath;
+    bool memoryReport = false;
+};
+
+// Helper: run a C API scan; null if the path is missing, the scan failed or it was cancelled
+static FolderSizeResultPtr runScan(const ScanRequest& request) {
+    try {
+        if (request.rootPath.empty() || !fs::exists(request.rootPath)) {
+            std::cerr << "Error: path does not exist: " << (request.rootPath.empty() ? "null" : request.rootPath) << std::endl;
+            return nullptr;
+        }
+        
+        FZC calculator(true, request.maxThreads, request.useAllocatedSize, request.includeDirectorySize, request.useIoUring);
+        calculator.setOneFileSystem(request.oneFileSystem);
+        calculator.setProgress(request.progress);
+        if (!request.snapshotPath.empty()) calculator.setSnapshotPath(request.snapshotPath);
+        if (!request.tracePath.empty()) calculator.setTracePath(request.tracePath);
+        calculator.setMemoryReport(request.memoryReport);
+        auto result = calculator.calculateFolderSizes(request.rootPath, request.rootOnly, request.cancellationToken);
+        
+        // Check if we got valid result (could be null due to cancellation)
+        if (!result.rootNode) {
+            return nullptr;
         }
+        
+        return static_cast<void*>(new FolderSizeResult(std::move(result)));
+    } catch (const std::exception& e) {
+        std::cerr << "Error calculating folder sizes: " << e.what() << std::endl;
+        return nullptr;
     }
-    return false;
 }
 
 // C-style interface for Swift or other language interoperability
 extern "C" {
     FolderSizeResultPtr calculateFolderSizes(const char* rootPath, bool rootOnly, bool useAllocatedSize, bool includeDirectorySize, void* cancellationToken) {
+        ScanRequest request;
+        request.rootPath = rootPath ? rootPath : "";
+        request.rootOnly = rootOnly;
+        request.useAllocatedSize = useAllocatedSize;
+        request.includeDirectorySize = includeDirectorySize;
+        request.cancellationToken = static_cast<CancellationToken*>(cancellationToken);
+        return runScan(request);
+    }
+    
+    ScanRequestPtr createScanRequest(const char* rootPath) {
+        auto* request = new ScanRequest();
+        request->rootPath = rootPath ? rootPath : "";
+        return static_cast<void*>(request);
+    }
+    void setScanRootOnly(ScanRequestPtr request, bool rootOnly) {
+        if (request) static_cast<ScanRequest*>(request)->rootOnly = rootOnly;
+    }
+    void setScanAllocatedSize(ScanRequestPtr request, bool useAllocatedSize) {
+        if (request) static_cast<ScanRequest*>(request)->useAllocatedSize = useAllocatedSize;
+    }
+    void setScanDirectorySize(ScanRequestPtr request, bool includeDirectorySize) {
+        if (request) static_cast<ScanRequest*>(request)->includeDirectorySize = includeDirectorySize;
+    }
+    void setScanMaxThreads(ScanRequestPtr request, int maxThreads) {
+        if (request) static_cast<ScanRequest*>(request)->maxThreads = maxThreads;
+    }
+    void setScanIoUring(ScanRequestPtr request, bool enabled) {
+        if (request) static_cast<ScanRequest*>(request)->useIoUring = enabled;
+    }
+    void setScanOneFileSystem(ScanRequestPtr request, bool enabled) {
+        if (request) static_cast<ScanRequest*>(request)->oneFileSystem = enabled;
+    }
+    void setScanCancellationToken(ScanRequestPtr request, void* cancellationToken) {
+        if (request) static_cast<ScanRequest*>(request)->cancellationToken = static_cast<CancellationToken*>(cancellationToken);
+    }
+    void setScanProgress(ScanRequestPtr request, void* progress) {
+        if (request) static_cast<ScanRequest*>(request)->progress = static_cast<ScanProgress*>(progress);
+    }
+    void setScanSnapshotPath(ScanRequestPtr request, const char* snapshotPath) {
+        if (request) static_cast<ScanRequest*>(request)->snapshotPath = snapshotPath ? snapshotPath : "";
+    }
+    void setScanTracePath(ScanRequestPtr request, const char* tracePath) {
+        if (request) static_cast<ScanRequest*>(request)->tracePath = tracePath ? tracePath : "";
+    }
+    void setScanMemoryReport(ScanRequestPtr request, bool enabled) {
+        if (request) static_cast<ScanRequest*>(request)->memoryReport = enabled;
+    }
+    FolderSizeResultPtr runScanRequest(ScanRequestPtr request) {
+        return request ? runScan(*static_cast<ScanRequest*>(request)) : nullptr;
+    }
+    void releaseScanRequest(ScanRequestPtr request) {
+        if (request) {
+            delete static_cast<ScanRequest*>(request);
+        }
+    }
+    
+    uint64_t scanWithCallbacks(const char* rootPath, bool useAllocatedSize, bool includeDirectorySize, const ScanCallbacks* callbacks, void* cancellationToken) {
+        // Adapts the C function pointers to a ScanVisitor
+        class CallbackVisitor : public ScanVisitor {
+        public:
+            explicit CallbackVisitor(const ScanCallbacks& callbacks) : m_callbacks(callbacks) {}
+            void onEnter(const std::string& path) override {
+                if (m_callbacks.onEnter) m_callbacks.onEnter(m_callbacks.context, path.c_str());
+            }
+            void onFile(const std::string& dirPath, const std::string& name, uint64_t size) override {
+                if (m_callbacks.onFile) m_callbacks.onFile(m_callbacks.context, dirPath.c_str(), name.c_str(), size);
+            }
+            void onLeave(const std::string& path, uint64_t dirTotal) override {
+                if (m_callbacks.onLeave) m_callbacks.onLeave(m_callbacks.context, path.c_str(), dirTotal);
+            }
+        private:
+            ScanCallbacks m_callbacks;
+        };
+        
         try {
-            // Check if path exists
             if (!rootPath || !fs::exists(rootPath)) {
                 std::cerr << "Error: path does not exist: " << (rootPath ? rootPath : "null") << std::endl;
-                return nullptr;
+                return 0;
             }
             
             CancellationToken* token = static_cast<CancellationToken*>(cancellationToken);
+            ScanCallbacks none{nullptr, nullptr, nullptr, nullptr};
+            CallbackVisitor visitor(callbacks ? *callbacks : none);
             
             FZC calculator(true, 0, useAllocatedSize, includeDirectorySize);
-            auto result = calculator.calculateFolderSizes(rootPath, rootOnly, token);
-            
-            // Check if we got valid result (could be null due to cancellation)
-            if (!result.rootNode) {
-                return nullptr;
-            }
-            
-            return static_cast<void*>(new FolderSizeResult(std::move(result)));
+            ScanSummary summary = calculator.scan(rootPath, visitor, token);
+            return summary.cancelled ? 0 : summary.totalSize;
         } catch (const std::exception& e) {
-            std::cerr << "Error calculating folder sizes: " << e.what() << std::endl;
-            return nullptr;
+            std::cerr << "Error scanning folder: " << e.what() << std::endl;
+            return 0;
         }
     }
     
+    // Functions for progress reporting; the getters are safe to call while a scan runs
+    void* createScanProgress() {
+        return static_cast<void*>(new ScanProgress());
+    }
+    void releaseScanProgress(void* progress) {
+        if (progress) {
+            delete static_cast<ScanProgress*>(progress);
+        }
+    }
+    uint64_t getProgressEntries(void* progress) {
+        return progress ? static_cast<ScanProgress*>(progress)->entries() : 0;
+    }
+    uint64_t getProgressBytes(void* progress) {
+        return progress ? static_cast<ScanProgress*>(progress)->bytes() : 0;
+    }
+    uint64_t getProgressDirectoriesPending(void* progress) {
+        return progress ? static_cast<ScanProgress*>(progress)->directoriesPending() : 0;
+    }
+    uint64_t getProgressDirectoriesCompleted(void* progress) {
+        return progress ? static_cast<ScanProgress*>(progress)->directoriesCompleted() : 0;
+    }
+    uint64_t getProgressErrors(void* progress) {
+        return progress ? static_cast<ScanProgress*>(progress)->errors() : 0;
+    }
+    double getProgressEntriesPerSecond(void* progress) {
+        return progress ? static_cast<ScanProgress*>(progress)->entriesPerSecond() : 0.0;
+    }
+    double getProgressBytesPerSecond(void* progress) {
+        return progress ? static_cast<ScanProgress*>(progress)->bytesPerSecond() : 0.0;
+    }
+    double getProgressIdleMs(void* progress) {
+        return progress ? static_cast<ScanProgress*>(progress)->idleMs() : 0.0;
+    }
+    bool isProgressRunning(void* progress) {
+        return progress ? static_cast<ScanProgress*>(progress)->isRunning() : false;
+    }
+    
     // Functions for cancellation token management
     void* createCancellationToken() {
         return static_cast<void*>(new CancellationToken());
@@ -541,6 +1296,30 @@ extern "C" {
         return false;
     }
     
+    void setTokenKeepPartialResults(void* token, bool keep) {
+        if (token) {
+            static_cast<CancellationToken*>(token)->setKeepPartialResults(keep);
+        }
+    }
+    
+    void setTokenTimeLimitMs(void* token, uint64_t milliseconds) {
+        if (token && milliseconds > 0) {
+            static_cast<CancellationToken*>(token)->setTimeLimit(std::chrono::milliseconds(milliseconds));
+        }
+    }
+    
+    void setTokenMaxEntries(void* token, uint64_t maxEntries) {
+        if (token) {
+            static_cast<CancellationToken*>(token)->setMaxEntries(maxEntries);
+        }
+    }
+    
+    void setTokenMaxSyscalls(void* token, uint64_t maxSyscalls) {
+        if (token) {
+            static_cast<CancellationToken*>(token)->setMaxSyscalls(maxSyscalls);
+        }
+    }
+    
     void releaseCancellationToken(void* token) {
         if (token) {
             delete static_cast<CancellationToken*>(token);
@@ -550,44 +1329,209 @@ extern "C" {
     FileNodePtr getResultRootNode(FolderSizeResultPtr result) {
         if (!result) return nullptr;
         auto folderResult = static_cast<FolderSizeResult*>(result);
-        return static_cast<void*>(new std::shared_ptr<FileNode>(folderResult->rootNode));
+        if (!folderResult->rootNode) return nullptr;
+        return static_cast<void*>(new FileNodeHandle(folderResult->tree, folderResult->rootIndex));
     }
     double getResultElapsedTimeMs(FolderSizeResultPtr result) {
         if (!result) return 0.0;
         auto folderResult = static_cast<FolderSizeResult*>(result);
         return folderResult->elapsedTimeMs;
     }
+    uint64_t getResultHardLinkSavings(FolderSizeResultPtr result) {
+        if (!result) return 0;
+        auto folderResult = static_cast<FolderSizeResult*>(result);
+        return folderResult->hardLinkSavings;
+    }
+    bool isResultComplete(FolderSizeResultPtr result) {
+        if (!result) return false;
+        auto folderResult = static_cast<FolderSizeResult*>(result);
+        return folderResult->isComplete;
+    }
+    int getResultStopReason(FolderSizeResultPtr result) {
+        if (!result) return static_cast<int>(StopReason::None);
+        auto folderResult = static_cast<FolderSizeResult*>(result);
+        return static_cast<int>(folderResult->stopReason);
+    }
+    uint64_t getResultTruncatedAt(FolderSizeResultPtr result) {
+        if (!result) return 0;
+        auto folderResult = static_cast<FolderSizeResult*>(result);
+        return folderResult->truncatedAt;
+    }
+    uint64_t getResultSparseFiles(FolderSizeResultPtr result) {
+        if (!result) return 0;
+        auto folderResult = static_cast<FolderSizeResult*>(result);
+        return folderResult->sparseFiles;
+    }
+    uint64_t getResultReusedDirectories(FolderSizeResultPtr result) {
+        if (!result) return 0;
+        auto folderResult = static_cast<FolderSizeResult*>(result);
+        return folderResult->reusedDirectories;
+    }
+    bool saveResult(FolderSizeResultPtr result, const char* file) {
+        if (!result || !file) return false;
+        return static_cast<FolderSizeResult*>(result)->save(file);
+    }
+    FolderSizeResultPtr loadResult(const char* file) {
+        if (!file) return nullptr;
+        auto result = FolderSizeResult::load(file);
+        if (!result.rootNode) return nullptr;
+        return static_cast<void*>(new FolderSizeResult(std::move(result)));
+    }
+    ResultDiffPtr diffResults(FolderSizeResultPtr before, FolderSizeResultPtr after, uint64_t minDelta, int maxEntries) {
+        if (!before || !after) return nullptr;
+        try {
+            DiffOptions options;
+            options.minDelta = minDelta;
+            options.maxEntries = maxEntries > 0 ? static_cast<size_t>(maxEntries) : 0;
+            return static_cast<void*>(new ResultDiff(FolderSizeResult::diff(
+                *static_cast<FolderSizeResult*>(before), *static_cast<FolderSizeResult*>(after), options)));
+        } catch (const std::exception& e) {
+            std::cerr << "Error comparing results: " << e.what() << std::endl;
+            return nullptr;
+        }
+    }
+    int getDiffCount(ResultDiffPtr diff) {
+        if (!diff) return 0;
+        return static_cast<int>(static_cast<ResultDiff*>(diff)->entries.size());
+    }
+    // Helper: entry of a diff by index, or nullptr if out of range
+    static const DiffEntry* diffEntry(ResultDiffPtr diff, int index) {
+        if (!diff) return nullptr;
+        const auto& entries = static_cast<ResultDiff*>(diff)->entries;
+        if (index < 0 || index >= static_cast<int>(entries.size())) return nullptr;
+        return &entries[index];
+    }
+    const char* getDiffPath(ResultDiffPtr diff, int index) {
+        const DiffEntry* entry = diffEntry(diff, index);
+        return entry ? entry->path.c_str() : nullptr;
+    }
+    int getDiffKind(ResultDiffPtr diff, int index) {
+        const DiffEntry* entry = diffEntry(diff, index);
+        return entry ? static_cast<int>(entry->kind) : -1;
+    }
+    bool isDiffDirectory(ResultDiffPtr diff, int index) {
+        const DiffEntry* entry = diffEntry(diff, index);
+        return entry ? entry->isDirectory : false;
+    }
+    uint64_t getDiffOldSize(ResultDiffPtr diff, int index) {
+        const DiffEntry* entry = diffEntry(diff, index);
+        return entry ? entry->oldSize : 0;
+    }
+    uint64_t getDiffNewSize(ResultDiffPtr diff, int index) {
+        const DiffEntry* entry = diffEntry(diff, index);
+        return entry ? entry->newSize : 0;
+    }
+    int64_t getDiffTotalDelta(ResultDiffPtr diff) {
+        if (!diff) return 0;
+        return static_cast<ResultDiff*>(diff)->totalDelta;
+    }
+    void releaseDiff(ResultDiffPtr diff) {
+        if (diff) {
+            delete static_cast<ResultDiff*>(diff);
+        }
+    }
+    bool areResultStatsEnabled(FolderSizeResultPtr result) {
+        if (!result) return false;
+        return static_cast<FolderSizeResult*>(result)->stats.enabled;
+    }
+    uint64_t getResultStatCount(FolderSizeResultPtr result, int kind) {
+        if (!result || kind < 0 || kind >= STAT_KIND_COUNT) return 0;
+        return static_cast<FolderSizeResult*>(result)->stats.count[kind];
+    }
+    uint64_t getResultStatNanoseconds(FolderSizeResultPtr result, int kind) {
+        if (!result || kind < 0 || kind >= STAT_KIND_COUNT) return 0;
+        return static_cast<FolderSizeResult*>(result)->stats.nanoseconds[kind];
+    }
+    const char* getStatKindName(int kind) {
+        return ScanStats::name(static_cast<StatKind>(kind));
+    }
+    bool isResultMemoryReported(FolderSizeResultPtr result) {
+        if (!result) return false;
+        return static_cast<FolderSizeResult*>(result)->memory.enabled;
+    }
+    bool areAllAllocationsCounted(FolderSizeResultPtr result) {
+        if (!result) return false;
+        return static_cast<FolderSizeResult*>(result)->memory.allAllocations;
+    }
+    uint64_t getResultProcessPeakRss(FolderSizeResultPtr result) {
+        if (!result) return 0;
+        return static_cast<FolderSizeResult*>(result)->memory.processPeakRssBytes;
+    }
+    uint64_t getResultMemoryBytes(FolderSizeResultPtr result, int kind) {
+        if (!result || kind < 0 || kind >= MEMORY_KIND_COUNT) return 0;
+        return static_cast<FolderSizeResult*>(result)->memory.bytes[kind];
+    }
+    uint64_t getResultMemoryAllocations(FolderSizeResultPtr result, int kind) {
+        if (!result || kind < 0 || kind >= MEMORY_KIND_COUNT) return 0;
+        return static_cast<FolderSizeResult*>(result)->memory.allocations[kind];
+    }
+    uint64_t getResultMemoryPeakLive(FolderSizeResultPtr result, int kind) {
+        if (!result || kind < 0 || kind >= MEMORY_KIND_COUNT) return 0;
+        return static_cast<FolderSizeResult*>(result)->memory.peakLiveBytes[kind];
+    }
+    uint64_t getResultPhaseBytes(FolderSizeResultPtr result, int phase) {
+        if (!result || phase < 0 || phase >= SCAN_PHASE_COUNT) return 0;
+        return static_cast<FolderSizeResult*>(result)->memory.phaseBytes[phase];
+    }
+    uint64_t getResultPhaseAllocations(FolderSizeResultPtr result, int phase) {
+        if (!result || phase < 0 || phase >= SCAN_PHASE_COUNT) return 0;
+        return static_cast<FolderSizeResult*>(result)->memory.phaseAllocations[phase];
+    }
+    const char* getMemoryKindName(int kind) {
+        return MemoryReport::name(static_cast<MemoryKind>(kind));
+    }
+    const char* getScanPhaseName(int phase) {
+        return MemoryReport::name(static_cast<ScanPhase>(phase));
+    }
     const char* getNodePath(FileNodePtr node) {
         if (!node) return nullptr;
-        auto fileNode = *static_cast<std::shared_ptr<FileNode>*>(node);
-        return fileNode->path.c_str();
+        auto handle = static_cast<FileNodeHandle*>(node);
+        if (handle->path.empty()) handle->path = handle->tree->path(handle->index);
+        return handle->path.c_str();
     }
     uint64_t getNodeSize(FileNodePtr node) {
         if (!node) return 0;
-        auto fileNode = *static_cast<std::shared_ptr<FileNode>*>(node);
-        return fileNode->size;
+        auto handle = static_cast<FileNodeHandle*>(node);
+        return handle->node().size;
     }
     bool isNodeDirectory(FileNodePtr node) {
         if (!node) return false;
-        auto fileNode = *static_cast<std::shared_ptr<FileNode>*>(node);
-        return fileNode->isDirectory;
+        auto handle = static_cast<FileNodeHandle*>(node);
+        return handle->node().isDirectory;
+    }
+    bool isNodeComplete(FileNodePtr node) {
+        if (!node) return false;
+        auto handle = static_cast<FileNodeHandle*>(node);
+        return handle->node().isComplete;
+    }
+    bool isNodeSparse(FileNodePtr node) {
+        if (!node) return false;
+        auto handle = static_cast<FileNodeHandle*>(node);
+        return handle->node().isSparse;
     }
     int getChildrenCount(FileNodePtr node) {
         if (!node) return 0;
-        auto fileNode = *static_cast<std::shared_ptr<FileNode>*>(node);
-        return static_cast<int>(fileNode->children.size());
+        auto handle = static_cast<FileNodeHandle*>(node);
+        return static_cast<int>(handle->node().childCount);
     }
     FileNodePtr getChildNode(FileNodePtr node, int index) {
         if (!node) return nullptr;
-        auto fileNode = *static_cast<std::shared_ptr<FileNode>*>(node);
-        if (index < 0 || index >= fileNode->children.size()) {
+        auto handle = static_cast<FileNodeHandle*>(node);
+        if (!handle->childrenLoaded) {
+            const FileTree& tree = *handle->tree;
+            for (NodeIndex child = handle->node().firstChild; child != INVALID_NODE; child = tree.node(child).nextSibling) {
+                handle->children.push_back(child);
+            }
+            handle->childrenLoaded = true;
+        }
+        if (index < 0 || index >= static_cast<int>(handle->children.size())) {
             return nullptr;
         }
-        return static_cast<void*>(new std::shared_ptr<FileNode>(fileNode->children[index]));
+        return static_cast<void*>(new FileNodeHandle(handle->tree, handle->children[index]));
     }
     void releaseFileNode(FileNodePtr node) {
         if (node) {
-            delete static_cast<std::shared_ptr<FileNode>*>(node);
+            delete static_cast<FileNodeHandle*>(node);
         }
     }
     void releaseResult(FolderSizeResultPtr result) {
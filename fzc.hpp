@@ -16,106 +16,718 @@
 #include <unordered_map>
 #include <deque>
 #include <condition_variable>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <cstdint>
+#include <string_view>
 
 namespace fs = std::filesystem;
 
-// Node structure to represent files and directories in the tree
+class WorkStealingPool;
+class TaskGroup;
+class DevInoSet;
+class TopKCollector;
+struct SnapshotStat;
+struct StatsBlock;
+class TraceRecorder;
+class TraceSpan;
+class MemoryAccounting;
+class MountTable;
+class PathPrefixTrie;
+
+// Index of a node inside a FileTree
+using NodeIndex = uint32_t;
+constexpr NodeIndex INVALID_NODE = UINT32_MAX;
+
+// Node structure to represent files and directories in the tree.
+// Nodes live in a FileTree and refer to each other by index; children form a
+// singly linked list in display order (largest first). A node stores only its
+// own name (the root stores the scanned path); full paths are rebuilt from the
+// parent chain on demand.
 struct FileNode {
-    std::string path;      // Display path (can be full length)
-    std::string workPath;  // Working path (shortened if needed)
     uint64_t size;
+    uint32_t nameOffset;      // Offset of the NUL-terminated name in the tree's string arena
+    NodeIndex parent;
+    NodeIndex firstChild;
+    NodeIndex nextSibling;
+    uint32_t childCount;
+    uint16_t nameLength;
+    bool isDirectory : 1;
+    bool isSparse : 1;        // allocated size differs from apparent size (sparse or compressed file)
+    bool isComplete;          // false if a cancelled scan stopped before this subtree was fully walked
+};
+
+// Compact storage for a scan result: nodes in contiguous chunks addressed by
+// 32-bit indices, and names interned in a chunked string arena. Chunks double
+// in size, so a tree of any size is a few dozen allocations, appends are safe
+// from concurrent scan workers, and nodes never move once created.
+class FileTree {
+public:
+    FileTree();
+    ~FileTree();
+
+    FileTree(const FileTree&) = delete;
+    FileTree& operator=(const FileTree&) = delete;
+
+    // Append a node with no parent or children; safe to call concurrently
+    NodeIndex addNode(std::string_view name, uint64_t size, bool isDirectory);
+
+    // Link children under parent in the given order (replaces any previous children)
+    void setChildren(NodeIndex parent, const NodeIndex* children, size_t count);
+    template <typename Allocator>
+    void setChildren(NodeIndex parent, const std::vector<NodeIndex, Allocator>& children) {
+        setChildren(parent, children.data(), children.size());
+    }
+
+    FileNode& node(NodeIndex index) { return chunkSlot(m_nodeChunks, index); }
+    const FileNode& node(NodeIndex index) const { return chunkSlot(m_nodeChunks, index); }
+
+    // NUL-terminated name of a node, owned by the tree
+    const char* name(const FileNode& node) const { return &chunkSlot(m_stringChunks, node.nameOffset); }
+    std::string_view nameView(const FileNode& node) const { return {name(node), node.nameLength}; }
+
+    // Full path of a node, rebuilt by walking up the parent chain
+    std::string path(NodeIndex index) const;
+
+    size_t nodeCount() const { return m_nodeCount.load(); }
+
+    // Tree over nodes and names stored as flat arrays inside a private file
+    // mapping (see FolderSizeResult::load). Nothing is copied: the chunk tables
+    // point into the mapping, which the tree unmaps when destroyed. A mapped
+    // tree can be read and relinked but not grown.
+    static std::shared_ptr<FileTree> fromMapping(void* map, size_t mapSize, FileNode* nodes, uint32_t nodeCount,
+                                                 char* strings, uint64_t stringBytes);
+    bool isMapped() const { return m_map != nullptr; }
+
+private:
+    static constexpr unsigned NODE_BASE_BITS = 10;    // first node chunk holds 1024 nodes
+    static constexpr unsigned STRING_BASE_BITS = 16;  // first string chunk holds 64 KB
+    static constexpr unsigned MAX_CHUNKS = 48;
+
+    template <typename T>
+    struct ChunkTable {
+        unsigned baseBits;
+        std::atomic<T*> chunks[MAX_CHUNKS];
+    };
+
+    // Map a flat offset to (chunk, offset in chunk); chunk k holds 2^(baseBits + k) items
+    static inline void locate(unsigned baseBits, uint64_t offset, unsigned& chunk, uint64_t& within, uint64_t& capacity) {
+        uint64_t shifted = offset + (uint64_t(1) << baseBits);
+        unsigned highBit = 63 - __builtin_clzll(shifted);
+        chunk = highBit - baseBits;
+        capacity = uint64_t(1) << highBit;
+        within = shifted - capacity;
+    }
+
+    template <typename T>
+    static T& chunkSlot(const ChunkTable<T>& table, uint64_t offset) {
+        unsigned chunk;
+        uint64_t within, capacity;
+        locate(table.baseBits, offset, chunk, within, capacity);
+        return table.chunks[chunk].load(std::memory_order_acquire)[within];
+    }
+
+    template <typename T>
+    static T* ensureChunk(ChunkTable<T>& table, unsigned chunk, uint64_t capacity);
+
+    // Point every chunk at its slice of one contiguous array
+    template <typename T>
+    static void mapFlat(ChunkTable<T>& table, T* base, uint64_t count);
+
+    uint32_t allocateString(std::string_view value);
+
+    ChunkTable<FileNode> m_nodeChunks;
+    ChunkTable<char> m_stringChunks;
+    std::atomic<uint32_t> m_nodeCount{0};
+    std::atomic<uint64_t> m_stringBytes{0};
+    void* m_map = nullptr;      // set for trees viewing a file mapping
+    size_t m_mapSize = 0;
+};
+
+// Directory entry produced by a directory read, with the type reported by the kernel
+struct DirEntry {
+    std::string name;      // Bare entry name, resolved relative to the directory fd
+    unsigned char type;    // DT_* value, DT_UNKNOWN when the filesystem does not report it
+    struct stat st;        // Filled ahead of time by a batched stat engine, if any
+    bool hasStat = false;
+};
+
+// Why a scan stopped before walking everything
+enum class StopReason : int {
+    None = 0,
+    Cancelled = 1,      // cancel() was called
+    Deadline = 2,       // the wall-clock deadline passed
+    EntryBudget = 3,    // the max-entries budget was used up
+    SyscallBudget = 4,  // the max-syscalls budget was used up
+};
+
+// Operation classes timed by the scan instrumentation
+enum class StatKind : int {
+    Lstat = 0,          // the scan root
+    Stat,               // device of the scan root
+    Fstatat,            // per-entry metadata, synchronous
+    Statx,              // per-entry metadata batched through io_uring
+    Getattrlist,        // allocated-size queries (macOS)
+    Statfs,             // filesystem type of the scan root
+    Openat,
+    ReadDirectory,      // listing one directory (getdents64 or readdir)
+    Close,
+    LockWait,           // contended waits on the hard-link and visited-directory set locks
+    TaskSpawn,          // subdirectories handed to the worker pool
+    ChildSort,          // ordering children by size in processDirectoryParallel
+    Count
+};
+
+// Count and wall time of every StatKind over one scan. Only collected when the
+// library is built with FZC_ENABLE_STATS (CMake option of the same name);
+// otherwise enabled is false and everything is zero. Times are summed across
+// workers, so they can exceed the scan's elapsed time.
+struct ScanStats {
+    bool enabled = false;
+    uint64_t count[static_cast<int>(StatKind::Count)] = {};
+    uint64_t nanoseconds[static_cast<int>(StatKind::Count)] = {};
+
+    uint64_t countOf(StatKind kind) const { return count[static_cast<int>(kind)]; }
+    uint64_t nanosecondsOf(StatKind kind) const { return nanoseconds[static_cast<int>(kind)]; }
+    static const char* name(StatKind kind);
+};
+
+// Structures the memory report breaks out
+enum class MemoryKind : int {
+    Nodes = 0,          // FileTree node chunks
+    Strings,            // FileTree name arena chunks
+    ChildLists,         // per-directory child index lists, before they are linked into the tree
+    DirEntries,         // directory listings and stat batches
+    Count
+};
+
+// Scan phases the memory report attributes allocations to
+enum class ScanPhase : int {
+    Setup = 0,          // before the walk: result tree, snapshot and trace set-up
+    Enumerate,          // listing directories (getdents64, snapshot reuse, io_uring statx)
+    Record,             // stat'ing entries, adding nodes, handing subdirectories to the pool
+    Link,               // merging child results, sorting and linking children
+    Finalize,           // after the walk: snapshot write and result collection
+    Count
+};
+
+// Memory use of one scan (FZC::setMemoryReport). Bytes and allocation counts
+// per MemoryKind come from the library's own counting allocators and are always
+// complete. Phase counts include those, plus every other allocation when the
+// application forwards its global operator new to AllocationCounter::noteOperatorNew
+// (fzc_cli does); allAllocations says whether that happened.
+struct MemoryReport {
+    bool enabled = false;
+    bool allAllocations = false;
+    // Lifetime high-water mark of the whole process when the scan ended (getrusage), not
+    // of this scan: in a long-lived host it repeats the largest earlier peak
+    uint64_t processPeakRssBytes = 0;
+    uint64_t bytes[static_cast<int>(MemoryKind::Count)] = {};
+    uint64_t allocations[static_cast<int>(MemoryKind::Count)] = {};
+    uint64_t peakLiveBytes[static_cast<int>(MemoryKind::Count)] = {};  // most held at once, across all threads
+    uint64_t phaseBytes[static_cast<int>(ScanPhase::Count)] = {};
+    uint64_t phaseAllocations[static_cast<int>(ScanPhase::Count)] = {};
+
+    uint64_t bytesOf(MemoryKind kind) const { return bytes[static_cast<int>(kind)]; }
+    uint64_t allocationsOf(MemoryKind kind) const { return allocations[static_cast<int>(kind)]; }
+    uint64_t allocationsIn(ScanPhase phase) const { return phaseAllocations[static_cast<int>(phase)]; }
+    static const char* name(MemoryKind kind);
+    static const char* name(ScanPhase phase);
+};
+
+// Entry points of the memory report. Each counts against the scan running on
+// the calling thread, and does nothing outside a memory-reported scan.
+struct AllocationCounter {
+    static void* allocate(MemoryKind kind, size_t bytes);
+    static void deallocate(MemoryKind kind, void* pointer, size_t bytes);
+    // Memory obtained elsewhere (FileTree chunks come from malloc)
+    static void note(MemoryKind kind, size_t bytes);
+    // Hook for an application-wide operator new; must not allocate
+    static void noteOperatorNew(size_t bytes);
+};
+
+// std::allocator that counts into the memory report under Kind
+template <typename T, MemoryKind Kind>
+struct CountingAllocator {
+    using value_type = T;
+    template <typename U> struct rebind { using other = CountingAllocator<U, Kind>; };
+
+    CountingAllocator() = default;
+    template <typename U> CountingAllocator(const CountingAllocator<U, Kind>&) {}
+
+    T* allocate(size_t n) { return static_cast<T*>(AllocationCounter::allocate(Kind, n * sizeof(T))); }
+    void deallocate(T* pointer, size_t n) { AllocationCounter::deallocate(Kind, pointer, n * sizeof(T)); }
+
+    template <typename U> bool operator==(const CountingAllocator<U, Kind>&) const { return true; }
+    template <typename U> bool operator!=(const CountingAllocator<U, Kind>&) const { return false; }
+};
+
+using ChildList = std::vector<NodeIndex, CountingAllocator<NodeIndex, MemoryKind::ChildLists>>;
+using DirEntryList = std::vector<DirEntry, CountingAllocator<DirEntry, MemoryKind::DirEntries>>;
+
+// How an entry differs between two results
+enum class DiffKind : int {
+    Added = 0,      // only in the newer result (reported once per added subtree)
+    Removed = 1,    // only in the older result (reported once per removed subtree)
+    Grown = 2,
+    Shrunk = 3,
+};
+
+struct DiffEntry {
+    std::string path;       // under the newer result's root
+    DiffKind kind;
     bool isDirectory;
-    std::vector<std::shared_ptr<FileNode>> children;
-    
-    FileNode(const std::string& p, const std::string& wp, uint64_t s, bool isDir) 
-        : path(p), workPath(wp), size(s), isDirectory(isDir) {}
+    uint64_t oldSize;       // 0 for Added
+    uint64_t newSize;       // 0 for Removed
+    int64_t delta() const { return static_cast<int64_t>(newSize) - static_cast<int64_t>(oldSize); }
+};
+
+struct DiffOptions {
+    uint64_t minDelta = 0;  // leave out entries that changed by fewer bytes
+    size_t maxEntries = 0;  // keep only the largest changes (0 = all)
 };
 
-// Result structure that includes timing information
+// Changes between two results, largest absolute delta first
+struct ResultDiff {
+    std::vector<DiffEntry> entries;
+    int64_t totalDelta = 0;             // change of the root size
+    uint64_t comparedDirectories = 0;   // directory pairs whose children were matched by name
+    uint64_t prunedDirectories = 0;     // identical subtrees skipped by size and identity hash
+    double elapsedTimeMs = 0.0;
+};
+
+// Result structure that includes timing information.
+// The result owns the node arena; handing it out via shared_ptr lets C API node
+// handles outlive the result object itself.
 struct FolderSizeResult {
-    std::shared_ptr<FileNode> rootNode;
+    std::shared_ptr<FileTree> tree;
+    NodeIndex rootIndex;
+    const FileNode* rootNode;   // nullptr if the scan failed or was cancelled
     double elapsedTimeMs;
+    uint64_t hardLinkSavings = 0; // bytes not counted again for extra links to the same inode
+    bool isComplete = true;       // false for a partial tree kept from a cancelled scan
+    StopReason stopReason = StopReason::None;
+    uint64_t truncatedAt = 0;     // entries scanned when a deadline or budget stopped the scan
+    uint64_t reusedDirectories = 0; // unchanged directories taken from the snapshot without listing them
+    uint64_t sparseFiles = 0;     // files whose allocated size differs from their apparent size
+    ScanStats stats;              // per-operation counters (FZC_ENABLE_STATS builds only)
+    MemoryReport memory;          // allocation counters (FZC::setMemoryReport only)
     
-    FolderSizeResult(std::shared_ptr<FileNode> node, double timeMs)
-        : rootNode(node), elapsedTimeMs(timeMs) {}
+    FolderSizeResult(std::shared_ptr<FileTree> t, NodeIndex root, double timeMs)
+        : tree(std::move(t)), rootIndex(root),
+          rootNode(tree && root != INVALID_NODE ? &tree->node(root) : nullptr),
+          elapsedTimeMs(timeMs) {}
+
+    // Write the result to a versioned binary file: a header, the node array and
+    // the name table, all position independent. Replaced atomically; false on failure.
+    bool save(const std::string& file) const;
+
+    // Map a saved result without parsing or copying it; the tree reads the file
+    // pages directly. rootNode is nullptr if the file is missing or invalid.
+    static FolderSizeResult load(const std::string& file);
+
+    // Walk both trees in lockstep by name and report added, removed, grown and
+    // shrunk entries. Subtrees with equal size and equal identity hash (names,
+    // sizes and types of everything below) are skipped without being walked.
+    static ResultDiff diff(const FolderSizeResult& before, const FolderSizeResult& after, const DiffOptions& options = DiffOptions());
+};
+
+// One entry of a top-K listing
+struct TopKEntry {
+    std::string path;
+    uint64_t size;
+};
+
+// Result of a top-K scan: only the K largest files and directories are kept,
+// no tree is materialized
+struct TopKResult {
+    std::vector<TopKEntry> largestFiles;        // largest first
+    std::vector<TopKEntry> largestDirectories;  // largest first, excluding the scan root
+    uint64_t totalSize = 0;
+    uint64_t hardLinkSavings = 0;
+    double elapsedTimeMs = 0.0;
+    bool isComplete = true;   // false if a cancelled scan kept partial results
+    StopReason stopReason = StopReason::None;
+    uint64_t truncatedAt = 0;
+};
+
+// Totals of a streaming scan; the entries themselves went to the visitor
+struct ScanSummary {
+    uint64_t totalSize = 0;
+    uint64_t hardLinkSavings = 0;
+    double elapsedTimeMs = 0.0;
+    bool cancelled = false;
+    StopReason stopReason = StopReason::None;
+    uint64_t truncatedAt = 0;
+};
+
+// Receives entries while a scan walks the tree. Callbacks are made from the
+// pool's worker threads, concurrently, so implementations must be thread-safe.
+// Every onEnter is matched by an onLeave carrying the directory's total,
+// unless the scan is cancelled in between.
+class ScanVisitor {
+public:
+    virtual ~ScanVisitor() = default;
+    virtual void onEnter(const std::string& /*path*/) {}
+    // Files and symlinks; size is 0 for unreadable entries and repeated hard links
+    virtual void onFile(const std::string& /*dirPath*/, const std::string& /*name*/, uint64_t /*size*/) {}
+    virtual void onLeave(const std::string& /*path*/, uint64_t /*dirTotal*/) {}
+};
+
+// Live counters of a running scan, readable from any thread without locking.
+// The scanner publishes once per batch of entries rather than per entry, so
+// readers see values that trail the walk by at most one batch per worker.
+class ScanProgress {
+public:
+    uint64_t entries() const { return m_entries.load(std::memory_order_relaxed); }
+    uint64_t bytes() const { return m_bytes.load(std::memory_order_relaxed); }
+    uint64_t directoriesCompleted() const { return m_directoriesCompleted.load(std::memory_order_relaxed); }
+    uint64_t directoriesPending() const {
+        uint64_t found = m_directoriesFound.load(std::memory_order_relaxed);
+        uint64_t completed = directoriesCompleted();
+        return found > completed ? found - completed : 0;
+    }
+    uint64_t errors() const { return m_errors.load(std::memory_order_relaxed); }
+    bool isRunning() const { return m_running.load(std::memory_order_acquire); }
+
+    // Seconds since the scan started (frozen once it finishes)
+    double elapsedSeconds() const {
+        int64_t end = isRunning() ? nowNs() : m_lastActivityNs.load(std::memory_order_relaxed);
+        return (end - m_startNs.load(std::memory_order_relaxed)) / 1e9;
+    }
+    // Current throughput, measured over windows of about a second between reads. Until
+    // the first window has passed, and once the scan has finished, the average is returned.
+    double entriesPerSecond() const { return currentRate(m_entriesWindow, entries()); }
+    double bytesPerSecond() const { return currentRate(m_bytesWindow, bytes()); }
+
+    // Milliseconds since any counter last advanced; a large value on a running scan means it is stalled
+    double idleMs() const {
+        if (!isRunning()) return 0.0;
+        return (nowNs() - m_lastActivityNs.load(std::memory_order_relaxed)) / 1e6;
+    }
+
+private:
+    friend class FZC;
+
+    static int64_t nowNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static constexpr int64_t RATE_WINDOW_NS = 1000000000;
+
+    // Counter value at the start of the current rate window, and the rate of the last full one
+    struct RateWindow {
+        std::atomic<int64_t> startNs{0};
+        std::atomic<uint64_t> startCount{0};
+        std::atomic<double> lastRate{-1.0};   // negative until a window has completed
+
+        void reset(int64_t now) {
+            startNs.store(now, std::memory_order_relaxed);
+            startCount.store(0, std::memory_order_relaxed);
+            lastRate.store(-1.0, std::memory_order_relaxed);
+        }
+    };
+
+    double rate(uint64_t count) const {
+        double seconds = elapsedSeconds();
+        return seconds > 0 ? count / seconds : 0.0;
+    }
+
+    double currentRate(RateWindow& window, uint64_t count) const {
+        if (!isRunning()) return rate(count);
+        int64_t now = nowNs();
+        int64_t start = window.startNs.load(std::memory_order_relaxed);
+        // The reader that closes a window starts the next one; concurrent readers keep the published rate
+        if (now - start >= RATE_WINDOW_NS &&
+            window.startNs.compare_exchange_strong(start, now, std::memory_order_relaxed)) {
+            uint64_t startCount = window.startCount.exchange(count, std::memory_order_relaxed);
+            uint64_t delta = count > startCount ? count - startCount : 0;
+            window.lastRate.store(delta / ((now - start) / 1e9), std::memory_order_relaxed);
+        }
+        double last = window.lastRate.load(std::memory_order_relaxed);
+        return last >= 0 ? last : rate(count);
+    }
+
+    void start() {
+        m_entries.store(0, std::memory_order_relaxed);
+        m_bytes.store(0, std::memory_order_relaxed);
+        m_directoriesFound.store(0, std::memory_order_relaxed);
+        m_directoriesCompleted.store(0, std::memory_order_relaxed);
+        m_errors.store(0, std::memory_order_relaxed);
+        int64_t now = nowNs();
+        m_startNs.store(now, std::memory_order_relaxed);
+        m_lastActivityNs.store(now, std::memory_order_relaxed);
+        m_entriesWindow.reset(now);
+        m_bytesWindow.reset(now);
+        m_running.store(true, std::memory_order_release);
+    }
+
+    void finish() {
+        m_lastActivityNs.store(nowNs(), std::memory_order_relaxed);
+        m_running.store(false, std::memory_order_release);
+    }
+
+    // Long listings and stat rounds report liveness without counting anything yet
+    void touch() { m_lastActivityNs.store(nowNs(), std::memory_order_relaxed); }
+
+    void addBatch(uint64_t entries, uint64_t bytes, uint64_t directories) {
+        if (entries) m_entries.fetch_add(entries, std::memory_order_relaxed);
+        if (bytes) m_bytes.fetch_add(bytes, std::memory_order_relaxed);
+        if (directories) m_directoriesFound.fetch_add(directories, std::memory_order_relaxed);
+        m_lastActivityNs.store(nowNs(), std::memory_order_relaxed);
+    }
+
+    // Each counter has its own cache line; workers update them concurrently
+    alignas(64) std::atomic<uint64_t> m_entries{0};
+    alignas(64) std::atomic<uint64_t> m_bytes{0};
+    alignas(64) std::atomic<uint64_t> m_directoriesFound{0};
+    alignas(64) std::atomic<uint64_t> m_directoriesCompleted{0};
+    alignas(64) std::atomic<uint64_t> m_errors{0};
+    alignas(64) std::atomic<int64_t> m_lastActivityNs{0};
+    std::atomic<int64_t> m_startNs{0};
+    std::atomic<bool> m_running{false};
+    // Advanced by readers of the rates
+    mutable RateWindow m_entriesWindow;
+    mutable RateWindow m_bytesWindow;
 };
 
-// Cancellation token for stopping calculations
+// Cancellation token for stopping calculations.
+// Besides explicit cancel(), a token can carry a deadline and entry/syscall
+// budgets. The scanner charges its work to the token once per batch, and checks
+// it after every directory read and io_uring stat round, so the limits are
+// enforced cooperatively with a granularity of one batch or one read per
+// worker. Budgets count over the token's lifetime: use one token per scan.
 class CancellationToken {
 private:
     std::atomic<bool> m_cancelled{false};
+    std::atomic<bool> m_keepPartialResults{false};
+    std::atomic<int> m_stopReason{static_cast<int>(StopReason::None)};
+    std::atomic<int64_t> m_deadlineNs{0};       // steady_clock time, 0 = none
+    std::atomic<uint64_t> m_maxEntries{0};      // 0 = unlimited
+    std::atomic<uint64_t> m_maxSyscalls{0};     // 0 = unlimited
+    std::atomic<uint64_t> m_entries{0};
+    std::atomic<uint64_t> m_syscalls{0};
+    std::atomic<uint64_t> m_truncatedAt{0};
+
+    static int64_t nowNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // The first reason wins; later limits do not overwrite it
+    void stop(StopReason reason) {
+        int expected = static_cast<int>(StopReason::None);
+        if (m_stopReason.compare_exchange_strong(expected, static_cast<int>(reason))) {
+            m_truncatedAt.store(m_entries.load());
+        }
+        m_cancelled.store(true);
+    }
     
 public:
     bool isCancelled() const { return m_cancelled.load(); }
-    void cancel() { m_cancelled.store(true); }
+    void cancel() { stop(StopReason::Cancelled); }
+
+    // When set, a cancelled scan returns what it aggregated so far, with
+    // unfinished nodes flagged incomplete, instead of an empty result.
+    // Deadline and budget stops always keep partial results.
+    bool keepPartialResults() const {
+        StopReason reason = stopReason();
+        return m_keepPartialResults.load() || (reason != StopReason::None && reason != StopReason::Cancelled);
+    }
+    void setKeepPartialResults(bool keep) { m_keepPartialResults.store(keep); }
+
+    void setDeadline(std::chrono::steady_clock::time_point deadline) {
+        m_deadlineNs.store(std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()).count());
+    }
+    void setTimeLimit(std::chrono::milliseconds limit) { setDeadline(std::chrono::steady_clock::now() + limit); }
+    void setMaxEntries(uint64_t maxEntries) { m_maxEntries.store(maxEntries); }
+    void setMaxSyscalls(uint64_t maxSyscalls) { m_maxSyscalls.store(maxSyscalls); }
+
+    // Called by the scanner for work it has done; trips the token once a limit is reached
+    void charge(uint64_t entries, uint64_t syscalls) {
+        uint64_t totalEntries = entries ? m_entries.fetch_add(entries) + entries : m_entries.load();
+        uint64_t totalSyscalls = syscalls ? m_syscalls.fetch_add(syscalls) + syscalls : m_syscalls.load();
+        if (m_cancelled.load()) return;
+        uint64_t maxEntries = m_maxEntries.load();
+        uint64_t maxSyscalls = m_maxSyscalls.load();
+        int64_t deadline = m_deadlineNs.load();
+        if (maxEntries && totalEntries >= maxEntries) stop(StopReason::EntryBudget);
+        else if (maxSyscalls && totalSyscalls >= maxSyscalls) stop(StopReason::SyscallBudget);
+        else if (deadline && nowNs() >= deadline) stop(StopReason::Deadline);
+    }
+
+    StopReason stopReason() const { return static_cast<StopReason>(m_stopReason.load()); }
+    // Entries charged when the token tripped (0 if it never did)
+    uint64_t truncatedAt() const { return m_truncatedAt.load(); }
+    uint64_t entriesCharged() const { return m_entries.load(); }
+    uint64_t syscallsCharged() const { return m_syscalls.load(); }
 };
 
 // Main class for calculating folder sizes
 class FZC {
 public:
     // Constructor with configurable parallelism and options
-    FZC(bool useParallelProcessing = true, int maxThreads = 0, bool useAllocatedSize = true, bool includeDirectorySize = true);
+    // useIoUring selects the batched io_uring statx engine on Linux; it falls back to fstatat when unavailable
+    FZC(bool useParallelProcessing = true, int maxThreads = 0, bool useAllocatedSize = true, bool includeDirectorySize = true, bool useIoUring = false);
+    ~FZC();
 
     // Calculate sizes and return the root node with timing information
     FolderSizeResult calculateFolderSizes(const std::string& path, bool rootOnly = false, CancellationToken* cancellationToken = nullptr);
 
+    // Walk the same way, but keep only the k largest files and directories
+    TopKResult calculateTopK(const std::string& path, size_t k, CancellationToken* cancellationToken = nullptr);
+
+    // Walk the same way, streaming every entry to the visitor instead of building a tree
+    ScanSummary scan(const std::string& path, ScanVisitor& visitor, CancellationToken* cancellationToken = nullptr);
+
+    // Publish live counters of every following scan into progress (nullptr to stop); progress must outlive the scans
+    void setProgress(ScanProgress* progress) { m_progress = progress; }
+
+    // Reuse unchanged directories from a snapshot file in calculateFolderSizes, and
+    // refresh the file after every complete scan (empty to disable); see fzc_snapshot.hpp
+    void setSnapshotPath(const std::string& file) { m_snapshotPath = file; }
+
+    // Record a timeline of every following scan (directory, enumerate, batch, wait
+    // and sort spans per worker) and write it to file as Chrome trace JSON when
+    // the scan ends (empty to disable); see fzc_trace.hpp
+    void setTracePath(const std::string& file) { m_tracePath = file; }
+
+    // Count allocations of every following calculateFolderSizes by structure and
+    // phase, and report them with the peak RSS in FolderSizeResult::memory
+    void setMemoryReport(bool enabled) { m_memoryReport = enabled; }
+
+    // Stay on the scan root's filesystem: directories on any other device are
+    // kept as empty nodes and not walked (like du -x). Without it, only network,
+    // removable and pseudo filesystems are left out; see fzc_mounts.hpp
+    void setOneFileSystem(bool enabled) { m_oneFileSystem = enabled; }
+
 private:
+    // Outcome of scanning one entry; node is INVALID_NODE when no tree is being built
+    struct DirResult {
+        bool counted = false;   // false for cancelled or already visited directories
+        bool complete = true;   // false if cancellation cut this subtree short
+        NodeIndex node = INVALID_NODE;
+        uint64_t size = 0;
+    };
+
+
     // Ensure temporary directory exists
     static void ensureTempDirExists();
     
     // Process a single file
-    std::shared_ptr<FileNode> processFile(const std::string& path, CancellationToken* cancellationToken = nullptr);
+    DirResult processFile(const std::string& path, const struct stat& st, CancellationToken* cancellationToken = nullptr);
     
     // Parallel version of directory processing
-    std::shared_ptr<FileNode> processDirectoryParallel(const std::string& path, int depth, bool rootOnly, CancellationToken* cancellationToken = nullptr);
+    // cached is the directory's node in the previous snapshot, if any.
+    // parentFd is AT_FDCWD for the root and for directories opened by path
+    // (past the fd budget); path is then used to open the directory.
+    DirResult processDirectoryParallel(int parentFd, const std::string& name, const std::string& path, const struct stat& st, int depth, bool rootOnly, CancellationToken* cancellationToken = nullptr, NodeIndex cached = INVALID_NODE);
     
     // Helper function to get file size
     uint64_t getFileSize(const std::string& path);
     
-    // Helper function to process a batch of entries
-    void processBatch(
-        std::vector<fs::directory_entry>& batch,
-        std::shared_ptr<FileNode>& node,
+    // Helper function to process a batch of entries; returns false if cancellation cut it short.
+    // dirFd is AT_FDCWD when the directory was closed early; entries are then resolved by path.
+    // clean is cleared if an entry could not be stat'ed or read.
+    bool processBatch(
+        int dirFd,
+        const std::string& dirPath,
+        DirEntryList& batch,
+        uint64_t& dirTotal,
+        ChildList& children,
         int depth,
-        std::vector<std::future<std::shared_ptr<FileNode>>>& futures,
+        TaskGroup* group,
+        std::deque<DirResult>& childResults,
+        NodeIndex cached,
+        bool& clean,
         CancellationToken* cancellationToken = nullptr);
 
+    // Shared scan plumbing for calculateFolderSizes and calculateTopK
+    void beginScan(const std::string& path);
+    DirResult processRoot(const std::string& path, bool rootOnly, CancellationToken* cancellationToken);
+    int currentSlot() const;
+    NodeIndex recordFile(ChildList& children, const std::string& dirPath, const std::string& name, uint64_t size, bool sparse = false);
+    bool reuseSnapshot(NodeIndex cached, const struct stat& st, const std::string& dirPath, uint64_t& dirTotal, ChildList& children, DirEntryList& entries, CancellationToken* cancellationToken);
+    void recordSnapshotStat(NodeIndex node, const SnapshotStat& record);
+    void leaveDirectory(const std::string& path, int depth, const DirResult& result);
+    void endScan();
+    void bindStats();
+    TraceSpan traceSpan(const char* name) const;
+    ScanStats collectStats() const;
+    MemoryReport collectMemory() const;
+    void noteError() { if (m_progress) m_progress->m_errors.fetch_add(1, std::memory_order_relaxed); }
+    bool keepListing(CancellationToken* cancellationToken);
+
     // Configuration
     bool m_useParallelProcessing;
     int m_maxThreads;
-    int m_maxDepthForParallelism;
     bool m_useAllocatedSize;
     bool m_includeDirectorySize;
+    bool m_useIoUring;
     static constexpr size_t BATCH_SIZE = 64;
     
-    // Thread management
-    std::atomic<int> m_activeThreads{0};
-    std::mutex m_threadMutex;
-    
-    // Cache for processed paths
-    std::unordered_set<std::string> m_processedPaths;
-    std::mutex m_cacheMutex;
-    
-    // Map to store working path to full path mapping
-    std::unordered_map<std::string, std::string> m_pathMap;
-    std::mutex m_pathMapMutex;
-
-    bool isSymLink(const std::string& path);
-    std::pair<uint64_t, bool> getFileInfo(const std::string& path);
-    bool shouldSkipDirectory(const std::string& path);
-    std::unordered_set<std::string> getMountPoints();
-    bool isMountPoint(const std::string& path);
-    bool isSubPathOfMountPoint(const std::string& path);
-    std::unordered_set<std::string> m_mountPoints;
+    // Tree being filled by the current scan (owned by its FolderSizeResult)
+    FileTree* m_tree = nullptr;
+
+    // Top-K collector of the current scan (set only by calculateTopK)
+    TopKCollector* m_topK = nullptr;
+
+    // Visitor of the current scan (set only by scan)
+    ScanVisitor* m_visitor = nullptr;
+
+    // Live counters published during scans (optional, owned by the caller)
+    ScanProgress* m_progress = nullptr;
+
+    // Snapshot reused and refreshed by calculateFolderSizes (state is set only during such a scan)
+    struct SnapshotState;
+    std::string m_snapshotPath;
+    std::unique_ptr<SnapshotState> m_snapshot;
+
+    // Instrumentation blocks of the current scan, one per worker slot (FZC_ENABLE_STATS builds only)
+    std::vector<StatsBlock> m_stats;
+
+    // Timeline of the current scan (set only while a traced scan runs)
+    std::string m_tracePath;
+    std::unique_ptr<TraceRecorder> m_trace;
+
+    // Allocation counters of the current scan (set only while a memory-reported scan runs)
+    bool m_memoryReport = false;
+    std::unique_ptr<MemoryAccounting> m_memory;
+
+    // Inodes with st_nlink > 1 already counted in the current scan
+    std::unique_ptr<DevInoSet> m_hardLinks;
+    std::atomic<uint64_t> m_hardLinkSavings{0};
+
+    // Files of the current scan whose allocated size differs from their apparent size
+    std::atomic<uint64_t> m_sparseFiles{0};
+
+    // Directories already walked in the current scan, keyed by (st_dev, st_ino)
+    std::unique_ptr<DevInoSet> m_visitedDirs;
+
+    // Directory fds held open by running scans, and how many may be (half of RLIMIT_NOFILE).
+    // Past the budget a directory is closed once listed and its entries are reached by path.
+    std::atomic<int> m_openDirectories{0};
+    int m_directoryFdBudget = 0;
+
+    // Persistent work-stealing pool for directory tasks (null when running sequentially)
+    std::unique_ptr<WorkStealingPool> m_pool;
+
+
+    bool shouldSkipDirectory(const std::string& path, const struct stat& st);
+    std::unique_ptr<MountTable> m_mounts;
+    bool m_oneFileSystem = false;
     std::string m_entryPath;  // 保存入口路径
+    dev_t m_entryDev = 0;     // filesystem of the scan root
 
-    bool hasAccessPermission(const std::string& path);
     std::unordered_map<std::string, std::string> m_firmlinkMap; // key: installed system path, value: original system path
     std::vector<std::string> m_dataRoots; // 原始系统盘根路径
-    bool isCoveredByFirmlink(const std::string& path);
+    std::unique_ptr<PathPrefixTrie> m_firmlinkPrefixes; // <data root>/<firmlink target> for every pair
+    bool isCoveredByFirmlink(const std::string& path) const;
 
     std::string m_entryFsType;
-    uint64_t getFileSizeByFsType(const std::string& path);
+    uint64_t getFileSizeByFsType(int dirfd, const std::string& name, const struct stat& st, bool* sparse = nullptr);
+    uint64_t getLinkSize(const struct stat& st) const;
 };
 
 // C-style interface for Swift interoperability
@@ -123,26 +735,114 @@ extern "C" {
     // Opaque pointer types
     typedef void* FileNodePtr;
     typedef void* FolderSizeResultPtr;
+    typedef void* ResultDiffPtr;
+    typedef void* ScanRequestPtr;
     
     // Function to calculate folder sizes and return the result
     FolderSizeResultPtr calculateFolderSizes(const char* rootPath, bool rootOnly, bool useAllocatedSize, bool includeDirectorySize, void* cancellationToken);
     
+    // Scan requests: create one for a root path, change the settings that differ from
+    // the defaults, then run it (any number of times). Strings are copied; the token and
+    // progress block are borrowed and must outlive the runs that use them.
+    ScanRequestPtr createScanRequest(const char* rootPath);
+    void setScanRootOnly(ScanRequestPtr request, bool rootOnly);
+    void setScanAllocatedSize(ScanRequestPtr request, bool useAllocatedSize);          // default true
+    void setScanDirectorySize(ScanRequestPtr request, bool includeDirectorySize);      // default true
+    void setScanMaxThreads(ScanRequestPtr request, int maxThreads);                   // 0 picks a count
+    void setScanIoUring(ScanRequestPtr request, bool enabled);
+    void setScanOneFileSystem(ScanRequestPtr request, bool enabled);
+    void setScanCancellationToken(ScanRequestPtr request, void* cancellationToken);
+    void setScanProgress(ScanRequestPtr request, void* progress);
+    void setScanSnapshotPath(ScanRequestPtr request, const char* snapshotPath);       // null turns it off
+    void setScanTracePath(ScanRequestPtr request, const char* tracePath);             // null turns it off
+    void setScanMemoryReport(ScanRequestPtr request, bool enabled);
+    FolderSizeResultPtr runScanRequest(ScanRequestPtr request);
+    void releaseScanRequest(ScanRequestPtr request);
+    
     // Functions for cancellation token management
     void* createCancellationToken();
     void cancelToken(void* token);
     bool isTokenCancelled(void* token);
+    void setTokenKeepPartialResults(void* token, bool keep);
+    // Deadline (milliseconds from now) and budgets; 0 means no limit
+    void setTokenTimeLimitMs(void* token, uint64_t milliseconds);
+    void setTokenMaxEntries(void* token, uint64_t maxEntries);
+    void setTokenMaxSyscalls(void* token, uint64_t maxSyscalls);
     void releaseCancellationToken(void* token);
     
     // Functions to access node properties
     const char* getNodePath(FileNodePtr node);
     uint64_t getNodeSize(FileNodePtr node);
     bool isNodeDirectory(FileNodePtr node);
+    bool isNodeComplete(FileNodePtr node);
+    bool isNodeSparse(FileNodePtr node);
     int getChildrenCount(FileNodePtr node);
     FileNodePtr getChildNode(FileNodePtr node, int index);
     
     // Functions to access result properties
     FileNodePtr getResultRootNode(FolderSizeResultPtr result);
     double getResultElapsedTimeMs(FolderSizeResultPtr result);
+    uint64_t getResultHardLinkSavings(FolderSizeResultPtr result);
+    bool isResultComplete(FolderSizeResultPtr result);
+    int getResultStopReason(FolderSizeResultPtr result);         // StopReason value
+    uint64_t getResultTruncatedAt(FolderSizeResultPtr result);
+    uint64_t getResultSparseFiles(FolderSizeResultPtr result);
+    
+    // Streaming scan: callbacks run on worker threads while the walk proceeds
+    // (any of them may be null). Returns the total size, or 0 if the path is
+    // missing or the scan was cancelled.
+    typedef struct ScanCallbacks {
+        void* context;
+        void (*onEnter)(void* context, const char* path);
+        void (*onFile)(void* context, const char* dirPath, const char* name, uint64_t size);
+        void (*onLeave)(void* context, const char* path, uint64_t dirTotal);
+    } ScanCallbacks;
+    uint64_t scanWithCallbacks(const char* rootPath, bool useAllocatedSize, bool includeDirectorySize, const ScanCallbacks* callbacks, void* cancellationToken);
+    
+    // Directories taken from the snapshot of a scan request
+    uint64_t getResultReusedDirectories(FolderSizeResultPtr result);
+    // Instrumentation (all zero unless built with FZC_ENABLE_STATS); kind is a StatKind value
+    bool areResultStatsEnabled(FolderSizeResultPtr result);
+    uint64_t getResultStatCount(FolderSizeResultPtr result, int kind);
+    uint64_t getResultStatNanoseconds(FolderSizeResultPtr result, int kind);
+    const char* getStatKindName(int kind);
+    // Memory report (all zero unless requested); kind is a MemoryKind value, phase a ScanPhase value
+    bool isResultMemoryReported(FolderSizeResultPtr result);
+    bool areAllAllocationsCounted(FolderSizeResultPtr result);
+    uint64_t getResultProcessPeakRss(FolderSizeResultPtr result);   // lifetime peak of the process, not of the scan
+    uint64_t getResultMemoryBytes(FolderSizeResultPtr result, int kind);
+    uint64_t getResultMemoryAllocations(FolderSizeResultPtr result, int kind);
+    uint64_t getResultMemoryPeakLive(FolderSizeResultPtr result, int kind);
+    uint64_t getResultPhaseBytes(FolderSizeResultPtr result, int phase);
+    uint64_t getResultPhaseAllocations(FolderSizeResultPtr result, int phase);
+    const char* getMemoryKindName(int kind);
+    const char* getScanPhaseName(int phase);
+    // Binary result files: loading maps the file, and all node getters read it in place
+    bool saveResult(FolderSizeResultPtr result, const char* file);
+    FolderSizeResultPtr loadResult(const char* file);
+    
+    // Differences between two results (live or loaded), largest change first; maxEntries 0 keeps all
+    ResultDiffPtr diffResults(FolderSizeResultPtr before, FolderSizeResultPtr after, uint64_t minDelta, int maxEntries);
+    int getDiffCount(ResultDiffPtr diff);
+    const char* getDiffPath(ResultDiffPtr diff, int index);
+    int getDiffKind(ResultDiffPtr diff, int index);             // DiffKind value
+    bool isDiffDirectory(ResultDiffPtr diff, int index);
+    uint64_t getDiffOldSize(ResultDiffPtr diff, int index);
+    uint64_t getDiffNewSize(ResultDiffPtr diff, int index);
+    int64_t getDiffTotalDelta(ResultDiffPtr diff);
+    void releaseDiff(ResultDiffPtr diff);
+    // Progress reporting: create a counter block, set it on a scan request, and poll it from any thread
+    void* createScanProgress();
+    void releaseScanProgress(void* progress);
+    uint64_t getProgressEntries(void* progress);
+    uint64_t getProgressBytes(void* progress);
+    uint64_t getProgressDirectoriesPending(void* progress);
+    uint64_t getProgressDirectoriesCompleted(void* progress);
+    uint64_t getProgressErrors(void* progress);
+    double getProgressEntriesPerSecond(void* progress);
+    double getProgressBytesPerSecond(void* progress);
+    double getProgressIdleMs(void* progress);
+    bool isProgressRunning(void* progress);
     
     // Functions to free memory
     void releaseFileNode(FileNodePtr node);
@@ -0,0 +1,526 @@
+/*
+ * fzc_bench.cpp
+ *
+ * Reproducible benchmark for FZC: generates a deterministic synthetic tree
+ * (or takes an existing one), scans it across thread counts and prints the
+ * measurements as JSON.
+ *
+ * The generator uses its own PRNG (splitmix64) rather than <random>
+ * distributions, whose output differs between standard libraries, so a seed
+ * names the same tree everywhere. Files are sized with ftruncate (sparse)
+ * unless --write-data is given. For in-memory runs put --root on a tmpfs
+ * (the default is /dev/shm when present); to benchmark a real filesystem
+ * point it at a loop-mounted image.
+ */
+
+#include "fzc.hpp"
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/utsname.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+// Deterministic 64-bit generator; the same seed gives the same tree on every platform
+class SplitMix64 {
+public:
+    explicit SplitMix64(uint64_t seed) : m_state(seed) {}
+    uint64_t next() {
+        uint64_t z = (m_state += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+    // Uniform in [0, 1)
+    double unit() { return (next() >> 11) * (1.0 / 9007199254740992.0); }
+    uint64_t below(uint64_t bound) { return bound ? next() % bound : 0; }
+
+private:
+    uint64_t m_state;
+};
+
+enum class Shape { Balanced, Wide };
+enum class SizeDistribution { Fixed, Uniform, LogUniform };
+
+struct GeneratorConfig {
+    Shape shape = Shape::Balanced;
+    unsigned fanout = 8;            // subdirectories per directory (balanced)
+    unsigned depth = 4;             // directory levels below the root (balanced)
+    unsigned filesPerDir = 16;      // files per directory (balanced)
+    uint64_t wideFiles = 200000;    // files in the single directory (wide)
+    SizeDistribution sizes = SizeDistribution::LogUniform;
+    uint64_t minSize = 0;
+    uint64_t maxSize = 1 << 20;
+    double symlinkRatio = 0.02;     // share of files created as symlinks to an earlier file
+    double hardlinkRatio = 0.02;    // share of files created as hard links to an earlier file
+    uint64_t seed = 1;
+    bool writeData = false;
+};
+
+struct GeneratedTree {
+    uint64_t directories = 0;
+    uint64_t files = 0;
+    uint64_t symlinks = 0;
+    uint64_t hardlinks = 0;
+    uint64_t logicalBytes = 0;
+};
+
+class TreeGenerator {
+public:
+    explicit TreeGenerator(const GeneratorConfig& config) : m_config(config), m_random(config.seed) {}
+
+    bool generate(const std::string& root, GeneratedTree& out) {
+        if (mkdir(root.c_str(), 0755) != 0) {
+            std::cerr << "Error: cannot create " << root << ": " << strerror(errno) << "\n";
+            return false;
+        }
+        m_tree = &out;
+        out.directories = 1;
+        if (m_config.shape == Shape::Wide) return fillDirectory(root, m_config.wideFiles);
+        return generateLevel(root, 0);
+    }
+
+private:
+    bool generateLevel(const std::string& dir, unsigned level) {
+        if (!fillDirectory(dir, m_config.filesPerDir)) return false;
+        if (level >= m_config.depth) return true;
+        for (unsigned i = 0; i < m_config.fanout; ++i) {
+            char name[32];
+            std::snprintf(name, sizeof(name), "d%04u", i);
+            std::string child = dir + "/" + name;
+            if (mkdir(child.c_str(), 0755) != 0) {
+                std::cerr << "Error: cannot create " << child << ": " << strerror(errno) << "\n";
+                return false;
+            }
+            ++m_tree->directories;
+            if (!generateLevel(child, level + 1)) return false;
+        }
+        return true;
+    }
+
+    uint64_t drawSize() {
+        uint64_t low = m_config.minSize;
+        uint64_t high = std::max(m_config.maxSize, low);
+        switch (m_config.sizes) {
+            case SizeDistribution::Fixed:
+                return high;
+            case SizeDistribution::Uniform:
+                return low + m_random.below(high - low + 1);
+            case SizeDistribution::LogUniform: {
+                // Many small files and a long tail of large ones, like real trees
+                double logLow = std::log(static_cast<double>(low) + 1.0);
+                double logHigh = std::log(static_cast<double>(high) + 1.0);
+                return static_cast<uint64_t>(std::exp(logLow + m_random.unit() * (logHigh - logLow)) - 1.0);
+            }
+        }
+        return 0;
+    }
+
+    bool fillDirectory(const std::string& dir, uint64_t count) {
+        for (uint64_t i = 0; i < count; ++i) {
+            char name[32];
+            std::snprintf(name, sizeof(name), "f%06llu", static_cast<unsigned long long>(i));
+            std::string path = dir + "/" + name;
+            double kind = m_random.unit();
+            if (!m_regularFiles.empty() && kind < m_config.symlinkRatio) {
+                const std::string& target = m_regularFiles[m_random.below(m_regularFiles.size())];
+                if (symlink(target.c_str(), path.c_str()) != 0) return fail(path);
+                ++m_tree->symlinks;
+                continue;
+            }
+            if (!m_regularFiles.empty() && kind < m_config.symlinkRatio + m_config.hardlinkRatio) {
+                const std::string& target = m_regularFiles[m_random.below(m_regularFiles.size())];
+                if (link(target.c_str(), path.c_str()) != 0) return fail(path);
+                ++m_tree->hardlinks;
+                continue;
+            }
+            uint64_t size = drawSize();
+            int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+            if (fd < 0) return fail(path);
+            bool ok = m_config.writeData ? writeFill(fd, size) : ftruncate(fd, static_cast<off_t>(size)) == 0;
+            close(fd);
+            if (!ok) return fail(path);
+            m_regularFiles.push_back(path);
+            ++m_tree->files;
+            m_tree->logicalBytes += size;
+        }
+        return true;
+    }
+
+    static bool writeFill(int fd, uint64_t size) {
+        static const std::vector<char> block(1 << 16, 'x');
+        while (size > 0) {
+            size_t chunk = static_cast<size_t>(std::min<uint64_t>(size, block.size()));
+            ssize_t written = write(fd, block.data(), chunk);
+            if (written <= 0) return false;
+            size -= static_cast<uint64_t>(written);
+        }
+        return true;
+    }
+
+    bool fail(const std::string& path) {
+        std::cerr << "Error: cannot create " << path << ": " << strerror(errno) << "\n";
+        return false;
+    }
+
+    const GeneratorConfig& m_config;
+    SplitMix64 m_random;
+    GeneratedTree* m_tree = nullptr;
+    std::vector<std::string> m_regularFiles;
+};
+
+// Peak resident set size recorded in a resource usage report, in KB
+uint64_t peakRssKb(const struct rusage& usage) {
+#ifdef __APPLE__
+    return static_cast<uint64_t>(usage.ru_maxrss) / 1024;  // bytes on macOS
+#else
+    return static_cast<uint64_t>(usage.ru_maxrss);          // KB on Linux
+#endif
+}
+
+std::string jsonString(const std::string& value) {
+    std::string out = "\"";
+    for (char c : value) {
+        if (c == '"' || c == '\\') out += '\\';
+        if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+            continue;
+        }
+        out += c;
+    }
+    return out + "\"";
+}
+
+// Scan the tree once and describe the run as JSON fields (all but the peak RSS);
+// false if the scan failed
+bool scanOnce(const std::string& scanRoot, int threads, bool useAllocatedSize, bool useIoUring, std::string& fields) {
+    // A fresh calculator (pool start-up is not timed) and a token that counts syscalls
+    FZC calculator(threads > 1, threads, useAllocatedSize, true, useIoUring);
+    CancellationToken token;
+    FolderSizeResult result = calculator.calculateFolderSizes(scanRoot, false, &token);
+    if (!result.rootNode) return false;
+    uint64_t entries = result.tree->nodeCount();
+    // With FZC_ENABLE_STATS the measured syscall counts are used; otherwise the scanner's own tally
+    uint64_t syscalls = token.syscallsCharged();
+    if (result.stats.enabled) {
+        syscalls = 0;
+        for (StatKind kind : {StatKind::Lstat, StatKind::Stat, StatKind::Fstatat, StatKind::Statx,
+                              StatKind::Getattrlist, StatKind::Statfs, StatKind::Openat,
+                              StatKind::ReadDirectory, StatKind::Close}) {
+            syscalls += result.stats.countOf(kind);
+        }
+    }
+    double seconds = result.elapsedTimeMs / 1000.0;
+    std::ostringstream out;
+    out << "\"elapsedMs\": " << result.elapsedTimeMs
+        << ", \"entries\": " << entries
+        << ", \"entriesPerSecond\": " << (seconds > 0 ? entries / seconds : 0.0)
+        << ", \"syscalls\": " << syscalls
+        << ", \"syscallsPerEntry\": " << (entries ? static_cast<double>(syscalls) / entries : 0.0)
+        << ", \"syscallsMeasured\": " << (result.stats.enabled ? "true" : "false")
+        << ", \"totalBytes\": " << result.rootNode->size;
+    fields = out.str();
+    return true;
+}
+
+// Run one scan in a child process, so the peak RSS reported is that run's own and
+// not the lifetime peak of the benchmark; the child sends its fields back over a pipe
+bool measureRun(const std::string& scanRoot, int threads, bool useAllocatedSize, bool useIoUring, std::string& fields, uint64_t& rssKb) {
+    int fds[2];
+    if (pipe(fds) != 0) return false;
+    std::cout.flush();
+    std::cerr.flush();
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        std::string childFields;
+        bool ok = scanOnce(scanRoot, threads, useAllocatedSize, useIoUring, childFields);
+        for (size_t written = 0; ok && written < childFields.size();) {
+            ssize_t n = write(fds[1], childFields.data() + written, childFields.size() - written);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) ok = false;
+            else written += static_cast<size_t>(n);
+        }
+        _exit(ok ? 0 : 1);
+    }
+    close(fds[1]);
+    fields.clear();
+    char buffer[4096];
+    for (;;) {
+        ssize_t n = read(fds[0], buffer, sizeof(buffer));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        fields.append(buffer, static_cast<size_t>(n));
+    }
+    close(fds[0]);
+    int status = 0;
+    struct rusage usage;
+    while (wait4(pid, &status, 0, &usage) < 0) {
+        if (errno != EINTR) return false;
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 || fields.empty()) return false;
+    rssKb = peakRssKb(usage);
+    return true;
+}
+
+// Parse a whole decimal number in [min, max]; false for empty, signed, partial or out-of-range text
+bool parseUnsigned(const char* text, uint64_t min, uint64_t max, uint64_t& value) {
+    if (!text || *text < '0' || *text > '9') return false;
+    errno = 0;
+    char* end = nullptr;
+    unsigned long long parsed = std::strtoull(text, &end, 10);
+    if (errno != 0 || *end != '\0' || parsed < min || parsed > max) return false;
+    value = parsed;
+    return true;
+}
+
+// Parse a share in [0, 1]
+bool parseRatio(const char* text, double& value) {
+    if (!text || !*text) return false;
+    errno = 0;
+    char* end = nullptr;
+    double parsed = std::strtod(text, &end);
+    if (errno != 0 || *end != '\0' || !(parsed >= 0.0 && parsed <= 1.0)) return false;
+    value = parsed;
+    return true;
+}
+
+// Comma-separated positive thread counts; false if any item is not one
+bool parseThreadList(const std::string& list, std::vector<int>& threads) {
+    threads.clear();
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        uint64_t value = 0;
+        if (!parseUnsigned(item.c_str(), 1, 4096, value)) return false;
+        threads.push_back(static_cast<int>(value));
+    }
+    return !threads.empty();
+}
+
+const char* shapeName(Shape shape) { return shape == Shape::Wide ? "wide" : "balanced"; }
+
+const char* distributionName(SizeDistribution sizes) {
+    switch (sizes) {
+        case SizeDistribution::Fixed: return "fixed";
+        case SizeDistribution::Uniform: return "uniform";
+        default: return "loguniform";
+    }
+}
+
+void printUsage() {
+    std::cout << "Usage: fzc_bench [options]\n"
+              << "Tree generation:\n"
+              << "  --root DIR             Where to create the tree (default: /dev/shm or /tmp, fzc-bench-<pid>)\n"
+              << "  --existing DIR         Benchmark an existing tree instead of generating one\n"
+              << "  --shape balanced|wide  Balanced tree, or one giant directory (default: balanced)\n"
+              << "  --fanout N             Subdirectories per directory (default: 8)\n"
+              << "  --depth N              Directory levels (default: 4)\n"
+              << "  --files N              Files per directory, or in the wide directory (default: 16 / 200000)\n"
+              << "  --sizes fixed|uniform|loguniform  File size distribution (default: loguniform)\n"
+              << "  --min-size N, --max-size N        Size range in bytes (default: 0 .. 1048576)\n"
+              << "  --symlinks R, --hardlinks R       Share of files created as links (default: 0.02 each)\n"
+              << "  --seed N               Generator seed (default: 1)\n"
+              << "  --write-data           Write file contents instead of sparse ftruncate\n"
+              << "  --keep                 Leave the generated tree in place\n"
+              << "Harness:\n"
+              << "  --threads LIST         Comma-separated thread counts (default: 1,2,4,<cpus>)\n"
+              << "  --repeat N             Runs per thread count (default: 3)\n"
+              << "  --io-uring             Scan with the io_uring statx engine\n"
+              << "  --allocated-size       Count allocated sizes (st_blocks) instead of apparent sizes;\n"
+              << "                         sparse generated files then count close to 0 bytes\n"
+              << "  --output FILE          Write the JSON report to FILE instead of stdout\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    GeneratorConfig config;
+    std::string root;
+    std::string existing;
+    std::string outputPath;
+    std::vector<int> threadCounts;
+    int repeat = 3;
+    bool keep = false;
+    bool useIoUring = false;
+    bool filesGiven = false;
+    uint64_t files = 0;
+
+    bool useAllocatedSize = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        uint64_t number = 0;
+        bool valid = true;
+        if (arg == "-h" || arg == "--help") {
+            printUsage();
+            return 0;
+        } else if (arg == "--root" && hasValue) {
+            root = argv[++i];
+        } else if (arg == "--existing" && hasValue) {
+            existing = argv[++i];
+        } else if (arg == "--shape" && hasValue) {
+            std::string value = argv[++i];
+            valid = value == "wide" || value == "balanced";
+            config.shape = value == "wide" ? Shape::Wide : Shape::Balanced;
+        } else if (arg == "--fanout" && hasValue) {
+            valid = parseUnsigned(argv[++i], 1, UINT_MAX, number);
+            config.fanout = static_cast<unsigned>(number);
+        } else if (arg == "--depth" && hasValue) {
+            valid = parseUnsigned(argv[++i], 0, UINT_MAX, number);
+            config.depth = static_cast<unsigned>(number);
+        } else if (arg == "--files" && hasValue) {
+            valid = parseUnsigned(argv[++i], 0, UINT64_MAX, files);
+            filesGiven = true;
+        } else if (arg == "--sizes" && hasValue) {
+            std::string value = argv[++i];
+            valid = value == "fixed" || value == "uniform" || value == "loguniform";
+            config.sizes = value == "fixed" ? SizeDistribution::Fixed
+                         : value == "uniform" ? SizeDistribution::Uniform : SizeDistribution::LogUniform;
+        } else if (arg == "--min-size" && hasValue) {
+            valid = parseUnsigned(argv[++i], 0, UINT64_MAX, config.minSize);
+        } else if (arg == "--max-size" && hasValue) {
+            valid = parseUnsigned(argv[++i], 0, UINT64_MAX, config.maxSize);
+        } else if (arg == "--symlinks" && hasValue) {
+            valid = parseRatio(argv[++i], config.symlinkRatio);
+        } else if (arg == "--hardlinks" && hasValue) {
+            valid = parseRatio(argv[++i], config.hardlinkRatio);
+        } else if (arg == "--seed" && hasValue) {
+            valid = parseUnsigned(argv[++i], 0, UINT64_MAX, config.seed);
+        } else if (arg == "--write-data") {
+            config.writeData = true;
+        } else if (arg == "--keep") {
+            keep = true;
+        } else if (arg == "--threads" && hasValue) {
+            valid = parseThreadList(argv[++i], threadCounts);
+        } else if (arg == "--repeat" && hasValue) {
+            valid = parseUnsigned(argv[++i], 1, 1000000, number);
+            repeat = static_cast<int>(number);
+        } else if (arg == "--io-uring") {
+            useIoUring = true;
+        } else if (arg == "--allocated-size") {
+            useAllocatedSize = true;
+        } else if (arg == "--output" && hasValue) {
+            outputPath = argv[++i];
+        } else {
+            std::cerr << "Unknown option: " << arg << "\n";
+            printUsage();
+            return 1;
+        }
+        if (!valid) {
+            std::cerr << "Error: Invalid " << arg << " value: " << argv[i] << "\n";
+            printUsage();
+            return 1;
+        }
+    }
+    if (filesGiven) {
+        if (config.shape == Shape::Wide) config.wideFiles = files;
+        else config.filesPerDir = static_cast<unsigned>(files);
+    }
+    if (threadCounts.empty()) {
+        int cpus = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+        for (int count : {1, 2, 4}) {
+            if (count < cpus) threadCounts.push_back(count);
+        }
+        threadCounts.push_back(cpus);
+    }
+
+    // Generate the tree, unless an existing one was given
+    GeneratedTree generated;
+    double generateMs = 0.0;
+    std::string scanRoot = existing;
+    if (scanRoot.empty()) {
+        if (root.empty()) {
+            struct stat st;
+            root = (stat("/dev/shm", &st) == 0 && S_ISDIR(st.st_mode)) ? "/dev/shm" : "/tmp";
+            root += "/fzc-bench-" + std::to_string(getpid());
+        }
+        scanRoot = root;
+        auto start = std::chrono::steady_clock::now();
+        TreeGenerator generator(config);
+        if (!generator.generate(scanRoot, generated)) {
+            std::error_code ignored;
+            fs::remove_all(scanRoot, ignored);
+            return 1;
+        }
+        generateMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Each run scans in its own child process with a fresh calculator
+    std::ostringstream runs;
+    bool firstRun = true;
+    for (int threads : threadCounts) {
+        for (int run = 0; run < repeat; ++run) {
+            std::string fields;
+            uint64_t rssKb = 0;
+            if (!measureRun(scanRoot, threads, useAllocatedSize, useIoUring, fields, rssKb)) {
+                std::cerr << "Error: scan of " << scanRoot << " failed\n";
+                if (!keep && existing.empty()) {
+                    std::error_code ignored;
+                    fs::remove_all(scanRoot, ignored);
+                }
+                return 1;
+            }
+            runs << (firstRun ? "" : ",") << "\n    {\"threads\": " << threads << ", \"run\": " << run
+                 << ", " << fields << ", \"peakRssKb\": " << rssKb << "}";
+            firstRun = false;
+        }
+    }
+
+    struct utsname system;
+    std::string kernel = uname(&system) == 0 ? std::string(system.sysname) + " " + system.release : "unknown";
+    std::ostringstream report;
+    report << "{\n  \"system\": {\"kernel\": " << jsonString(kernel)
+           << ", \"cpus\": " << std::thread::hardware_concurrency() << "},\n"
+           << "  \"tree\": {\"root\": " << jsonString(scanRoot) << ", \"generated\": " << (existing.empty() ? "true" : "false");
+    if (existing.empty()) {
+        report << ", \"shape\": \"" << shapeName(config.shape) << "\", \"seed\": " << config.seed
+               << ", \"fanout\": " << config.fanout << ", \"depth\": " << config.depth
+               << ", \"filesPerDirectory\": " << (config.shape == Shape::Wide ? config.wideFiles : config.filesPerDir)
+               << ", \"sizes\": \"" << distributionName(config.sizes) << "\", \"minSize\": " << config.minSize
+               << ", \"maxSize\": " << config.maxSize << ", \"symlinkRatio\": " << config.symlinkRatio
+               << ", \"hardlinkRatio\": " << config.hardlinkRatio << ", \"writeData\": " << (config.writeData ? "true" : "false")
+               << ", \"directories\": " << generated.directories << ", \"files\": " << generated.files
+               << ", \"symlinks\": " << generated.symlinks << ", \"hardlinks\": " << generated.hardlinks
+               << ", \"logicalBytes\": " << generated.logicalBytes << ", \"generateMs\": " << generateMs;
+    }
+    report << "},\n  \"ioUring\": " << (useIoUring ? "true" : "false")
+           << ",\n  \"sizeMode\": \"" << (useAllocatedSize ? "allocated" : "apparent") << "\",\n"
+           << "  \"runs\": [" << runs.str() << "\n  ]\n}\n";
+
+    if (!keep && existing.empty()) {
+        std::error_code ignored;
+        fs::remove_all(scanRoot, ignored);
+    }
+    if (outputPath.empty()) {
+        std::cout << report.str();
+        return 0;
+    }
+    FILE* out = std::fopen(outputPath.c_str(), "w");
+    if (!out || std::fputs(report.str().c_str(), out) < 0) {
+        std::cerr << "Error: cannot write " << outputPath << "\n";
+        if (out) std::fclose(out);
+        return 1;
+    }
+    std::fclose(out);
+    return 0;
+}
@@ -0,0 +1,72 @@
+#ifndef FZC_DEVINO_HPP
+#define FZC_DEVINO_HPP
+
+#include "fzc_stats.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_set>
+#include <sys/types.h>
+
+// Concurrent set of (st_dev, st_ino) identities. Keys are spread over
+// independently locked shards, so parallel workers almost never wait on the
+// same mutex and there is no global lock on the hot path.
+class DevInoSet {
+public:
+    // Returns true if the identity was not in the set yet
+    bool insert(dev_t dev, ino_t ino) {
+        Key key{static_cast<uint64_t>(dev), static_cast<uint64_t>(ino)};
+        size_t hash = KeyHash()(key);
+        Shard& shard = m_shards[(hash >> 32) % SHARD_COUNT];
+#ifdef FZC_ENABLE_STATS
+        // Only contended acquisitions are timed; the uncontended path stays a single try_lock
+        std::unique_lock<std::mutex> lock(shard.mutex, std::try_to_lock);
+        if (!lock.owns_lock()) {
+            FZC_STAT_SCOPE(StatKind::LockWait);
+            lock.lock();
+        }
+#else
+        std::lock_guard<std::mutex> lock(shard.mutex);
+#endif
+        return shard.keys.insert(key).second;
+    }
+
+    void clear() {
+        for (auto& shard : m_shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.keys.clear();
+        }
+    }
+
+private:
+    static constexpr size_t SHARD_COUNT = 64;
+
+    struct Key {
+        uint64_t dev;
+        uint64_t ino;
+        bool operator==(const Key& other) const { return dev == other.dev && ino == other.ino; }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            // splitmix64 finalizer over the combined identity
+            uint64_t x = key.ino ^ (key.dev * 0x9e3779b97f4a7c15ULL);
+            x ^= x >> 30;
+            x *= 0xbf58476d1ce4e5b9ULL;
+            x ^= x >> 27;
+            x *= 0x94d049bb133111ebULL;
+            x ^= x >> 31;
+            return static_cast<size_t>(x);
+        }
+    };
+
+    // One cache line per shard header so neighbouring locks do not false-share
+    struct alignas(64) Shard {
+        std::mutex mutex;
+        std::unordered_set<Key, KeyHash> keys;
+    };
+
+    Shard m_shards[SHARD_COUNT];
+};
+
+#endif // FZC_DEVINO_HPP
@@ -0,0 +1,168 @@
+/*
+ * fzc_diff.cpp
+ *
+ * Comparison of two scan results (FolderSizeResult::diff).
+ */
+
+#include "fzc.hpp"
+#include <algorithm>
+#include <functional>
+
+namespace {
+
+inline uint64_t mixHash(uint64_t value) {
+    // splitmix64 finalizer
+    value += 0x9e3779b97f4a7c15ULL;
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+    return value ^ (value >> 31);
+}
+
+// Identity hash of every subtree under root, indexed by NodeIndex. Children
+// are combined by sum, so the display order of equal-sized siblings does not
+// matter. One iterative post-order pass; no name matching involved.
+std::vector<uint64_t> subtreeHashes(const FileTree& tree, NodeIndex root) {
+    std::vector<uint64_t> hashes(tree.nodeCount(), 0);
+    std::vector<std::pair<NodeIndex, bool>> stack{{root, false}};
+    while (!stack.empty()) {
+        auto& top = stack.back();
+        NodeIndex index = top.first;
+        const FileNode& node = tree.node(index);
+        if (!top.second) {
+            top.second = true;
+            for (NodeIndex child = node.firstChild; child != INVALID_NODE; child = tree.node(child).nextSibling) {
+                stack.emplace_back(child, false);
+            }
+            continue;
+        }
+        stack.pop_back();
+        uint64_t childSum = 0;
+        for (NodeIndex child = node.firstChild; child != INVALID_NODE; child = tree.node(child).nextSibling) {
+            childSum += hashes[child];
+        }
+        uint64_t own = std::hash<std::string_view>()(tree.nameView(node)) ^ mixHash(node.size) ^ (node.isDirectory ? 1 : 0);
+        hashes[index] = mixHash(own + mixHash(childSum));
+    }
+    return hashes;
+}
+
+// Children of a directory sorted by name, for the lockstep merge
+void sortedChildren(const FileTree& tree, NodeIndex directory, std::vector<NodeIndex>& out) {
+    out.clear();
+    for (NodeIndex child = tree.node(directory).firstChild; child != INVALID_NODE; child = tree.node(child).nextSibling) {
+        out.push_back(child);
+    }
+    std::sort(out.begin(), out.end(), [&tree](NodeIndex a, NodeIndex b) {
+        return tree.nameView(tree.node(a)) < tree.nameView(tree.node(b));
+    });
+}
+
+std::string childPath(const std::string& parent, std::string_view name) {
+    std::string path = parent;
+    if (path.empty() || path.back() != '/') path += '/';
+    path += name;
+    return path;
+}
+
+} // namespace
+
+ResultDiff FolderSizeResult::diff(const FolderSizeResult& before, const FolderSizeResult& after, const DiffOptions& options) {
+    auto startTime = std::chrono::high_resolution_clock::now();
+    ResultDiff result;
+    if (!before.rootNode || !after.rootNode) return result;
+
+    const FileTree& oldTree = *before.tree;
+    const FileTree& newTree = *after.tree;
+    std::vector<uint64_t> oldHashes = subtreeHashes(oldTree, before.rootIndex);
+    std::vector<uint64_t> newHashes = subtreeHashes(newTree, after.rootIndex);
+
+    auto report = [&](const std::string& path, DiffKind kind, bool isDirectory, uint64_t oldSize, uint64_t newSize) {
+        uint64_t magnitude = oldSize > newSize ? oldSize - newSize : newSize - oldSize;
+        if (magnitude == 0 || magnitude < options.minDelta) return;
+        result.entries.push_back({path, kind, isDirectory, oldSize, newSize});
+    };
+    auto reportChange = [&](const std::string& path, const FileNode& oldNode, const FileNode& newNode) {
+        report(path, newNode.size > oldNode.size ? DiffKind::Grown : DiffKind::Shrunk, newNode.isDirectory,
+               oldNode.size, newNode.size);
+    };
+
+    // The roots are compared whatever their names (e.g. two mount points of the same data)
+    struct Pair {
+        NodeIndex oldIndex;
+        NodeIndex newIndex;
+        std::string path;
+    };
+    const FileNode& oldRoot = *before.rootNode;
+    const FileNode& newRoot = *after.rootNode;
+    std::string rootPath = newTree.path(after.rootIndex);
+    result.totalDelta = static_cast<int64_t>(newRoot.size) - static_cast<int64_t>(oldRoot.size);
+    if (oldRoot.isDirectory != newRoot.isDirectory) {
+        report(rootPath, DiffKind::Removed, oldRoot.isDirectory, oldRoot.size, 0);
+        report(rootPath, DiffKind::Added, newRoot.isDirectory, 0, newRoot.size);
+    } else {
+        reportChange(rootPath, oldRoot, newRoot);
+    }
+
+    std::vector<Pair> pending;
+    if (oldRoot.isDirectory && newRoot.isDirectory) pending.push_back({before.rootIndex, after.rootIndex, rootPath});
+    std::vector<NodeIndex> oldChildren;
+    std::vector<NodeIndex> newChildren;
+    while (!pending.empty()) {
+        Pair pair = std::move(pending.back());
+        pending.pop_back();
+        ++result.comparedDirectories;
+        sortedChildren(oldTree, pair.oldIndex, oldChildren);
+        sortedChildren(newTree, pair.newIndex, newChildren);
+
+        size_t i = 0, j = 0;
+        while (i < oldChildren.size() || j < newChildren.size()) {
+            const FileNode* oldNode = i < oldChildren.size() ? &oldTree.node(oldChildren[i]) : nullptr;
+            const FileNode* newNode = j < newChildren.size() ? &newTree.node(newChildren[j]) : nullptr;
+            int order = !oldNode ? 1 : !newNode ? -1 : oldTree.nameView(*oldNode).compare(newTree.nameView(*newNode));
+            if (order < 0) {
+                report(childPath(pair.path, oldTree.nameView(*oldNode)), DiffKind::Removed, oldNode->isDirectory, oldNode->size, 0);
+                ++i;
+                continue;
+            }
+            if (order > 0) {
+                report(childPath(pair.path, newTree.nameView(*newNode)), DiffKind::Added, newNode->isDirectory, 0, newNode->size);
+                ++j;
+                continue;
+            }
+
+            NodeIndex oldIndex = oldChildren[i++];
+            NodeIndex newIndex = newChildren[j++];
+            if (oldNode->isDirectory != newNode->isDirectory) {
+                std::string path = childPath(pair.path, newTree.nameView(*newNode));
+                report(path, DiffKind::Removed, oldNode->isDirectory, oldNode->size, 0);
+                report(path, DiffKind::Added, newNode->isDirectory, 0, newNode->size);
+                continue;
+            }
+            if (oldNode->size == newNode->size && oldHashes[oldIndex] == newHashes[newIndex]) {
+                if (newNode->isDirectory) ++result.prunedDirectories;
+                continue;
+            }
+            std::string path = childPath(pair.path, newTree.nameView(*newNode));
+            reportChange(path, *oldNode, *newNode);
+            // Equal totals can still hide a grown and a shrunk entry below, so the size alone never prunes
+            if (newNode->isDirectory) pending.push_back({oldIndex, newIndex, std::move(path)});
+        }
+    }
+
+    auto byMagnitude = [](const DiffEntry& a, const DiffEntry& b) {
+        uint64_t magnitudeA = static_cast<uint64_t>(a.delta() < 0 ? -a.delta() : a.delta());
+        uint64_t magnitudeB = static_cast<uint64_t>(b.delta() < 0 ? -b.delta() : b.delta());
+        if (magnitudeA != magnitudeB) return magnitudeA > magnitudeB;
+        return a.path < b.path;
+    };
+    if (options.maxEntries > 0 && result.entries.size() > options.maxEntries) {
+        std::partial_sort(result.entries.begin(), result.entries.begin() + options.maxEntries, result.entries.end(), byMagnitude);
+        result.entries.resize(options.maxEntries);
+    } else {
+        std::sort(result.entries.begin(), result.entries.end(), byMagnitude);
+    }
+
+    auto endTime = std::chrono::high_resolution_clock::now();
+    result.elapsedTimeMs = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+    return result;
+}
@@ -0,0 +1,118 @@
+/*
+ * fzc_memory.cpp
+ *
+ * Allocation accounting for memory reports (MemoryAccounting, AllocationCounter).
+ */
+
+#include "fzc_memory.hpp"
+#include <new>
+#include <sys/resource.h>
+
+namespace {
+
+// Set while a counted allocation calls operator new, so the application hook
+// does not count the same allocation a second time
+thread_local bool t_inCountedAllocation = false;
+
+void countPhase(MemoryBlock* block, size_t bytes) {
+    int phase = static_cast<int>(t_memoryPhase);
+    block->phaseBytes[phase] += bytes;
+    ++block->phaseAllocations[phase];
+}
+
+} // namespace
+
+MemoryAccounting::MemoryAccounting(size_t slots) : m_blocks(slots) {
+    for (MemoryBlock& block : m_blocks) block.owner = this;
+    for (int kind = 0; kind < MEMORY_KIND_COUNT; ++kind) {
+        m_live[kind].store(0);
+        m_peakLive[kind].store(0);
+    }
+}
+
+void MemoryAccounting::addLive(MemoryKind kind, int64_t bytes) {
+    int index = static_cast<int>(kind);
+    int64_t live = m_live[index].fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    int64_t peak = m_peakLive[index].load(std::memory_order_relaxed);
+    while (live > peak && !m_peakLive[index].compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+    }
+}
+
+MemoryReport MemoryAccounting::collect() const {
+    MemoryReport report;
+    report.enabled = true;
+    for (const MemoryBlock& block : m_blocks) {
+        for (int kind = 0; kind < MEMORY_KIND_COUNT; ++kind) {
+            report.bytes[kind] += block.bytes[kind];
+            report.allocations[kind] += block.allocations[kind];
+        }
+        for (int phase = 0; phase < SCAN_PHASE_COUNT; ++phase) {
+            report.phaseBytes[phase] += block.phaseBytes[phase];
+            report.phaseAllocations[phase] += block.phaseAllocations[phase];
+        }
+        if (block.hooked) report.allAllocations = true;
+    }
+    for (int kind = 0; kind < MEMORY_KIND_COUNT; ++kind) {
+        report.peakLiveBytes[kind] = static_cast<uint64_t>(m_peakLive[kind].load());
+    }
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef __APPLE__
+        report.processPeakRssBytes = static_cast<uint64_t>(usage.ru_maxrss);         // bytes on macOS
+#else
+        report.processPeakRssBytes = static_cast<uint64_t>(usage.ru_maxrss) * 1024;  // KB on Linux
+#endif
+    }
+    return report;
+}
+
+void* AllocationCounter::allocate(MemoryKind kind, size_t bytes) {
+    MemoryBlock* block = t_memoryBlock;
+    if (!block) return ::operator new(bytes);
+    t_inCountedAllocation = true;
+    void* pointer;
+    try {
+        pointer = ::operator new(bytes);
+    } catch (...) {
+        t_inCountedAllocation = false;
+        throw;
+    }
+    t_inCountedAllocation = false;
+    note(kind, bytes);
+    return pointer;
+}
+
+void AllocationCounter::deallocate(MemoryKind kind, void* pointer, size_t bytes) {
+    // Containers are freed on the thread that filled them, inside the same scan
+    if (MemoryBlock* block = t_memoryBlock) block->owner->addLive(kind, -static_cast<int64_t>(bytes));
+    ::operator delete(pointer);
+}
+
+void AllocationCounter::note(MemoryKind kind, size_t bytes) {
+    MemoryBlock* block = t_memoryBlock;
+    if (!block) return;
+    int index = static_cast<int>(kind);
+    block->bytes[index] += bytes;
+    ++block->allocations[index];
+    countPhase(block, bytes);
+    block->owner->addLive(kind, static_cast<int64_t>(bytes));
+}
+
+void AllocationCounter::noteOperatorNew(size_t bytes) {
+    MemoryBlock* block = t_memoryBlock;
+    if (!block || t_inCountedAllocation) return;
+    block->hooked = true;
+    countPhase(block, bytes);
+}
+
+const char* MemoryReport::name(MemoryKind kind) {
+    static const char* names[MEMORY_KIND_COUNT] = {"nodes", "strings", "childLists", "dirEntries"};
+    int index = static_cast<int>(kind);
+    return index >= 0 && index < MEMORY_KIND_COUNT ? names[index] : "unknown";
+}
+
+const char* MemoryReport::name(ScanPhase phase) {
+    static const char* names[SCAN_PHASE_COUNT] = {"setup", "enumerate", "record", "link", "finalize"};
+    int index = static_cast<int>(phase);
+    return index >= 0 && index < SCAN_PHASE_COUNT ? names[index] : "unknown";
+}
@@ -0,0 +1,79 @@
+#ifndef FZC_MEMORY_HPP
+#define FZC_MEMORY_HPP
+
+#include "fzc.hpp"
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+// Allocation accounting behind FZC::setMemoryReport.
+//
+// A memory-reported scan owns one MemoryBlock per worker slot; each thread
+// binds its slot while it works on the scan, and the current ScanPhase is a
+// thread-local set by enterPhase. Counts and phase totals are plain adds into
+// the thread's own block. Only the live byte totals, whose peak has to be
+// taken across all threads at once, are shared atomics. Outside such a scan
+// the block pointer is null and every hook returns after one check.
+
+constexpr int MEMORY_KIND_COUNT = static_cast<int>(MemoryKind::Count);
+constexpr int SCAN_PHASE_COUNT = static_cast<int>(ScanPhase::Count);
+
+class MemoryAccounting;
+
+struct alignas(64) MemoryBlock {
+    MemoryAccounting* owner = nullptr;
+    uint64_t bytes[MEMORY_KIND_COUNT] = {};
+    uint64_t allocations[MEMORY_KIND_COUNT] = {};
+    uint64_t phaseBytes[SCAN_PHASE_COUNT] = {};
+    uint64_t phaseAllocations[SCAN_PHASE_COUNT] = {};
+    bool hooked = false;    // noteOperatorNew fired on this slot
+};
+
+// Block of the memory-reported scan running on this thread, or nullptr
+inline thread_local MemoryBlock* t_memoryBlock = nullptr;
+inline thread_local ScanPhase t_memoryPhase = ScanPhase::Setup;
+
+class MemoryAccounting {
+public:
+    explicit MemoryAccounting(size_t slots);
+
+    MemoryBlock* block(int slot) { return &m_blocks[slot]; }
+
+    void addLive(MemoryKind kind, int64_t bytes);
+
+    // Sum of all slots, with the process peak RSS
+    MemoryReport collect() const;
+
+private:
+    std::vector<MemoryBlock> m_blocks;
+    std::atomic<int64_t> m_live[MEMORY_KIND_COUNT];
+    std::atomic<int64_t> m_peakLive[MEMORY_KIND_COUNT];
+};
+
+// Binds the calling thread to a slot of a scan for the scope's lifetime (nothing
+// when accounting is null) and restores the previous binding, so pool workers
+// never keep a block once their task is done
+class MemoryScope {
+public:
+    MemoryScope(MemoryAccounting* accounting, int slot, ScanPhase phase)
+        : m_previousBlock(t_memoryBlock), m_previousPhase(t_memoryPhase) {
+        t_memoryBlock = accounting ? accounting->block(slot) : nullptr;
+        t_memoryPhase = phase;
+    }
+    ~MemoryScope() {
+        t_memoryBlock = m_previousBlock;
+        t_memoryPhase = m_previousPhase;
+    }
+    MemoryScope(const MemoryScope&) = delete;
+    MemoryScope& operator=(const MemoryScope&) = delete;
+
+private:
+    MemoryBlock* m_previousBlock;
+    ScanPhase m_previousPhase;
+};
+
+// Attribute the calling thread's following allocations to phase; the
+// enclosing MemoryScope puts the previous phase back
+inline void enterPhase(ScanPhase phase) { t_memoryPhase = phase; }
+
+#endif // FZC_MEMORY_HPP
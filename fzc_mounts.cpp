@@ -0,0 +1,113 @@
+/*
+ * fzc_mounts.cpp
+ *
+ * Mount table used for filesystem-crossing rules (MountTable).
+ */
+
+#include "fzc_mounts.hpp"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <sys/stat.h>
+#ifdef __APPLE__
+#include <sys/mount.h>
+#endif
+#ifdef __linux__
+#include <sys/sysmacros.h>
+#endif
+
+namespace {
+
+#ifdef __linux__
+// Kernel pseudo filesystems (no disk usage behind their sizes) and network filesystems
+bool isSkippedFsType(const std::string& type) {
+    static const std::unordered_set<std::string> skipped = {
+        "proc", "sysfs", "devtmpfs", "devpts", "cgroup", "cgroup2", "debugfs", "tracefs",
+        "securityfs", "pstore", "bpf", "mqueue", "hugetlbfs", "configfs", "fusectl", "autofs",
+        "binfmt_misc", "efivarfs", "rpc_pipefs", "nsfs", "selinuxfs",
+        "nfs", "nfs4", "cifs", "smb3", "smbfs", "ncpfs", "afs", "ceph", "glusterfs", "9p",
+        "fuse.sshfs", "fuse.rclone", "fuse.s3fs", "fuse.gcsfuse"};
+    return skipped.count(type) > 0;
+}
+#endif
+
+// Undo the octal escapes (\040 for space, \011, \012, \134) of mountinfo paths
+std::string unescapeMountPath(const std::string& field) {
+    std::string path;
+    path.reserve(field.size());
+    for (size_t i = 0; i < field.size(); ++i) {
+        if (field[i] == '\\' && i + 3 < field.size() &&
+            field[i + 1] >= '0' && field[i + 1] <= '7' && field[i + 2] >= '0' && field[i + 2] <= '7' &&
+            field[i + 3] >= '0' && field[i + 3] <= '7') {
+            path += static_cast<char>((field[i + 1] - '0') * 64 + (field[i + 2] - '0') * 8 + (field[i + 3] - '0'));
+            i += 3;
+            continue;
+        }
+        path += field[i];
+    }
+    return path;
+}
+
+} // namespace
+
+void MountTable::add(MountEntry entry) {
+    m_byDevice.emplace(entry.device, m_entries.size());
+    if (entry.skipped) m_skippedDevices.insert(entry.device);
+    m_entries.push_back(std::move(entry));
+}
+
+const MountEntry* MountTable::findByDevice(dev_t device) const {
+    auto it = m_byDevice.find(device);
+    return it == m_byDevice.end() ? nullptr : &m_entries[it->second];
+}
+
+MountTable MountTable::fromMountInfo(const std::string& text) {
+    MountTable table;
+#ifdef __linux__
+    // id parent major:minor root mountpoint options [optional...] - fstype source superoptions
+    std::istringstream lines(text);
+    std::string line;
+    while (std::getline(lines, line)) {
+        std::istringstream fields(line);
+        std::string id, parent, device, root, mountPoint, options, field;
+        if (!(fields >> id >> parent >> device >> root >> mountPoint >> options)) continue;
+        while (fields >> field && field != "-") {
+        }
+        std::string fsType;
+        if (field != "-" || !(fields >> fsType)) continue;
+        unsigned major = 0, minor = 0;
+        if (std::sscanf(device.c_str(), "%u:%u", &major, &minor) != 2) continue;
+        table.add({unescapeMountPath(mountPoint), fsType, makedev(major, minor), isSkippedFsType(fsType)});
+    }
+#else
+    (void)text;
+#endif
+    return table;
+}
+
+MountTable MountTable::load() {
+#ifdef __linux__
+    std::ifstream file("/proc/self/mountinfo");
+    if (!file) return MountTable();
+    std::stringstream text;
+    text << file.rdbuf();
+    return fromMountInfo(text.str());
+#elif defined(__APPLE__)
+    MountTable table;
+    struct statfs* mounts = nullptr;
+    int count = getmntinfo(&mounts, MNT_WAIT);
+    for (int i = 0; i < count; ++i) {
+        const struct statfs& fs = mounts[i];
+        // The root volume is always walked; other volumes unless local, fixed APFS
+        bool isRoot = strcmp(fs.f_mntonname, "/") == 0;
+        bool isApfs = strncmp(fs.f_fstypename, "apfs", 4) == 0;
+        bool skipped = !isRoot && ((fs.f_flags & MNT_LOCAL) == 0 || (fs.f_flags & MNT_REMOVABLE) || !isApfs);
+        // f_fsid.val[0] carries the volume's dev_t, as reported in st_dev
+        table.add({fs.f_mntonname, fs.f_fstypename, static_cast<dev_t>(fs.f_fsid.val[0]), skipped});
+    }
+    return table;
+#else
+    return MountTable();
+#endif
+}
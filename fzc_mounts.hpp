@@ -0,0 +1,48 @@
+#ifndef FZC_MOUNTS_HPP
+#define FZC_MOUNTS_HPP
+
+#include <string>
+#include <sys/types.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// One mounted filesystem
+struct MountEntry {
+    std::string path;       // mount point
+    std::string fsType;     // "ext4", "apfs", "nfs4", ...
+    dev_t device;           // st_dev of every entry on this filesystem
+    bool skipped;           // never descended into unless it is the scan root's own filesystem
+};
+
+// Mount table read once per FZC: /proc/self/mountinfo on Linux, getmntinfo on
+// macOS. Scans decide "is this directory on another filesystem?" from the
+// st_dev they already have, so crossing rules cost no syscall per directory.
+//
+// Skipped filesystems are the ones a size scan should not walk into from
+// elsewhere: network and removable volumes, and (macOS) anything but local
+// APFS; on Linux also kernel pseudo filesystems (proc, sysfs, cgroup, ...),
+// whose sizes are not disk usage.
+class MountTable {
+public:
+    static MountTable load();
+
+    // Parse the contents of a mountinfo file (format of proc(5))
+    static MountTable fromMountInfo(const std::string& text);
+
+    const std::vector<MountEntry>& entries() const { return m_entries; }
+
+    // Filesystem of a device, or nullptr if it is not in the table
+    const MountEntry* findByDevice(dev_t device) const;
+
+    bool isSkippedDevice(dev_t device) const { return m_skippedDevices.count(device) > 0; }
+
+private:
+    void add(MountEntry entry);
+
+    std::vector<MountEntry> m_entries;
+    std::unordered_map<dev_t, size_t> m_byDevice;    // first mount of each device
+    std::unordered_set<dev_t> m_skippedDevices;
+};
+
+#endif // FZC_MOUNTS_HPP
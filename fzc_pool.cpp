@@ -0,0 +1,182 @@
+/*
+ * fzc_pool.cpp
+ *
+ * Work-stealing thread pool used for parallel directory traversal.
+ */
+
+#include "fzc_pool.hpp"
+#include <chrono>
+
+namespace {
+// Identity of the calling thread, so submit() can push to the worker's own deque
+thread_local const WorkStealingPool* tl_pool = nullptr;
+thread_local int tl_workerIndex = -1;
+// Number of TaskGroup waits on this thread currently running unrelated pool tasks
+thread_local int tl_helpDepth = 0;
+}
+
+WorkStealingPool::WorkStealingPool(int threadCount) {
+    if (threadCount < 1) threadCount = 1;
+    for (int i = 0; i <= threadCount; ++i) {
+        m_queues.push_back(std::make_unique<WorkerQueue>());
+    }
+    m_workers.reserve(threadCount);
+    for (int i = 0; i < threadCount; ++i) {
+        m_workers.emplace_back([this, i]() { workerLoop(i); });
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_stop.store(true);
+    }
+    m_sleepCv.notify_all();
+    for (auto& worker : m_workers) {
+        worker.join();
+    }
+}
+
+int WorkStealingPool::currentWorkerIndex() const {
+    return tl_pool == this ? tl_workerIndex : -1;
+}
+
+void WorkStealingPool::submit(Task task) {
+    int index = currentWorkerIndex();
+    WorkerQueue& queue = *m_queues[index >= 0 ? index : m_workers.size()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+    m_queued.fetch_add(1);
+    {
+        // Take the sleep lock so a worker between its check and its wait cannot miss the wakeup
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+    }
+    m_sleepCv.notify_one();
+}
+
+bool WorkStealingPool::popLocal(int index, Task& task) {
+    WorkerQueue& queue = *m_queues[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) return false;
+    task = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+    return true;
+}
+
+bool WorkStealingPool::steal(int thief, Task& task) {
+    // Start with the injection queue, then walk the other workers from our neighbour on
+    int queueCount = static_cast<int>(m_queues.size());
+    int injection = queueCount - 1;
+    for (int i = 0; i < queueCount; ++i) {
+        int victim = (i == 0) ? injection : (thief + i + queueCount) % queueCount;
+        if (victim == thief || (i > 0 && victim == injection)) continue;
+        WorkerQueue& queue = *m_queues[victim];
+        std::unique_lock<std::mutex> lock(queue.mutex, std::try_to_lock);
+        if (!lock.owns_lock() || queue.tasks.empty()) continue;
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        return true;
+    }
+    return false;
+}
+
+bool WorkStealingPool::runPendingTask() {
+    int index = currentWorkerIndex();
+    Task task;
+    bool found = (index >= 0 && popLocal(index, task)) ||
+                 steal(index >= 0 ? index : static_cast<int>(m_workers.size()), task);
+    if (!found) return false;
+    m_queued.fetch_sub(1);
+    task();
+    return true;
+}
+
+void WorkStealingPool::workerLoop(int index) {
+    tl_pool = this;
+    tl_workerIndex = index;
+    while (!m_stop.load()) {
+        if (runPendingTask()) continue;
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        // Steal attempts can miss a queue that is briefly locked; the timeout bounds that window
+        m_sleepCv.wait_for(lock, std::chrono::milliseconds(10),
+                           [this]() { return m_stop.load() || m_queued.load() > 0; });
+    }
+}
+
+TaskGroup::TaskGroup(WorkStealingPool& pool) : m_pool(pool), m_state(std::make_shared<State>()) {}
+
+TaskGroup::~TaskGroup() {
+    // Tasks reference the caller's frame: never leave before they finish, and never throw here
+    drain();
+}
+
+bool TaskGroup::runOne(State& state, bool newest) {
+    WorkStealingPool::Task task;
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        if (state.tasks.empty()) return false;
+        if (newest) {
+            task = std::move(state.tasks.back());
+            state.tasks.pop_back();
+        } else {
+            task = std::move(state.tasks.front());
+            state.tasks.pop_front();
+        }
+    }
+    try {
+        task();
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        if (!state.error) state.error = std::current_exception();
+    }
+    state.pending.fetch_sub(1);
+    return true;
+}
+
+void TaskGroup::run(WorkStealingPool::Task task) {
+    {
+        std::lock_guard<std::mutex> lock(m_state->mutex);
+        m_state->tasks.push_back(std::move(task));
+    }
+    m_state->pending.fetch_add(1);
+    // One ticket per task; a ticket whose task the waiter already ran finds the queue empty
+    m_pool.submit([state = m_state]() { runOne(*state, false); });
+}
+
+void TaskGroup::drain() {
+    int idleSpins = 0;
+    while (m_state->pending.load() > 0) {
+        if (runOne(*m_state, true)) {
+            idleSpins = 0;
+            continue;
+        }
+        // Our own tasks are all running elsewhere; help the pool while the nesting allows
+        if (tl_helpDepth < MAX_HELP_DEPTH) {
+            ++tl_helpDepth;
+            bool ran = m_pool.runPendingTask();
+            --tl_helpDepth;
+            if (ran) {
+                idleSpins = 0;
+                continue;
+            }
+        }
+        if (++idleSpins < 64) {
+            std::this_thread::yield();
+        } else {
+            // Back off instead of spinning until the remaining tasks finish
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+}
+
+void TaskGroup::wait() {
+    drain();
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> lock(m_state->mutex);
+        std::swap(error, m_state->error);
+    }
+    if (error) std::rethrow_exception(error);
+}
@@ -0,0 +1,94 @@
+#ifndef FZC_POOL_HPP
+#define FZC_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent thread pool with one task deque per worker.
+// Workers push and pop their own tasks LIFO (depth first, hot caches) and steal
+// FIFO from other workers when idle, so large subtrees near the root get spread
+// across all cores at any depth. Threads outside the pool submit into a shared
+// injection queue and may help run tasks while they wait.
+class WorkStealingPool {
+public:
+    using Task = std::function<void()>;
+
+    explicit WorkStealingPool(int threadCount);
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    // Queue a task on the calling worker's deque, or on the injection queue from other threads
+    void submit(Task task);
+
+    // Run one queued task on the calling thread; returns false if none could be found
+    bool runPendingTask();
+
+    int threadCount() const { return static_cast<int>(m_workers.size()); }
+
+    // Index of the calling worker thread in this pool, or -1 for any other thread
+    int currentWorkerIndex() const;
+
+private:
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void workerLoop(int index);
+    bool popLocal(int index, Task& task);
+    bool steal(int thief, Task& task);
+
+    std::vector<std::unique_ptr<WorkerQueue>> m_queues; // one per worker, plus the injection queue last
+    std::vector<std::thread> m_workers;
+    std::atomic<int> m_queued{0};
+    std::atomic<bool> m_stop{false};
+    std::mutex m_sleepMutex;
+    std::condition_variable m_sleepCv;
+};
+
+// Group of tasks that can be waited on. The group keeps its own task queue and
+// only submits tickets to the pool, so the waiting thread can run the group's own
+// tasks instead of blocking. It helps with unrelated pool tasks only up to
+// MAX_HELP_DEPTH nested waits, which bounds stack depth (and anything the tasks
+// hold open, like directory fds) on the waiting thread.
+class TaskGroup {
+public:
+    static constexpr int MAX_HELP_DEPTH = 4;
+
+    explicit TaskGroup(WorkStealingPool& pool);
+    ~TaskGroup();
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    void run(WorkStealingPool::Task task);
+
+    // Block until every task has finished; rethrows the first exception a task threw
+    void wait();
+
+private:
+    struct State {
+        std::mutex mutex;
+        std::deque<WorkStealingPool::Task> tasks;
+        std::atomic<int> pending{0};
+        std::exception_ptr error;
+    };
+
+    // Run one task taken from the group queue (front for tickets, back for the waiter)
+    static bool runOne(State& state, bool newest);
+    void drain();
+
+    WorkStealingPool& m_pool;
+    std::shared_ptr<State> m_state;
+};
+
+#endif // FZC_POOL_HPP
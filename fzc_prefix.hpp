@@ -0,0 +1,89 @@
+#ifndef FZC_PREFIX_HPP
+#define FZC_PREFIX_HPP
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Set of directory prefixes compiled into a trie of path components, so
+// "is this path at or below one of the prefixes?" walks the path once, in
+// O(depth), without building or copying any string. Components are split on
+// '/' and '\\'; empty components (doubled or trailing separators) are ignored.
+// Matching is anchored at the root: prefixes and paths must be absolute, and a
+// relative path never matches, even if its components spell out a prefix.
+class PathPrefixTrie {
+public:
+    PathPrefixTrie() : m_nodes(1) {}
+
+    // Relative prefixes are ignored
+    void insert(std::string_view prefix) {
+        if (!isAbsolute(prefix)) return;
+        uint32_t node = 0;
+        forEachComponent(prefix, [&](std::string_view component) {
+            uint32_t child = findChild(node, component);
+            if (child == NONE) {
+                child = static_cast<uint32_t>(m_nodes.size());
+                m_nodes[node].children.emplace_back(std::string(component), child);
+                m_nodes.emplace_back();
+            }
+            node = child;
+            return true;
+        });
+        m_nodes[node].terminal = true;
+    }
+
+    bool empty() const { return m_nodes[0].children.empty() && !m_nodes[0].terminal; }
+
+    // True if path equals a prefix or lies below one
+    bool covers(std::string_view path) const {
+        if (!isAbsolute(path)) return false;
+        uint32_t node = 0;
+        bool covered = m_nodes[0].terminal;
+        forEachComponent(path, [&](std::string_view component) {
+            if (covered) return false;
+            node = findChild(node, component);
+            if (node == NONE) return false;
+            covered = m_nodes[node].terminal;
+            return true;
+        });
+        return covered;
+    }
+
+private:
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    struct Node {
+        // Few children per component, so a flat list beats a map
+        std::vector<std::pair<std::string, uint32_t>> children;
+        bool terminal = false;
+    };
+
+    static bool isAbsolute(std::string_view path) {
+        return !path.empty() && (path[0] == '/' || path[0] == '\\');
+    }
+
+    uint32_t findChild(uint32_t node, std::string_view component) const {
+        for (const auto& child : m_nodes[node].children) {
+            if (child.first == component) return child.second;
+        }
+        return NONE;
+    }
+
+    // Calls visit for each component until it returns false
+    template <typename Visit>
+    static void forEachComponent(std::string_view path, Visit visit) {
+        size_t start = 0;
+        while (start < path.size()) {
+            size_t end = path.find_first_of("/\\", start);
+            if (end == std::string_view::npos) end = path.size();
+            if (end > start && !visit(path.substr(start, end - start))) return;
+            start = end + 1;
+        }
+    }
+
+    std::vector<Node> m_nodes;
+};
+
+#endif // FZC_PREFIX_HPP
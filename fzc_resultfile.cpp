@@ -0,0 +1,180 @@
+/*
+ * fzc_resultfile.cpp
+ *
+ * Binary result files (FolderSizeResult::save / load).
+ *
+ * Layout: a fixed header, the FileNode array in index order, then the name
+ * table (NUL-terminated names, nameOffset relative to its start). Nodes refer
+ * to each other by index only, so the file is position independent and is
+ * used in place: load maps it privately (copy-on-write) and points the tree's
+ * chunk tables at the two arrays. Loading validates the header, the section
+ * bounds and, in one pass over the nodes, every link and name, so a damaged or
+ * hostile file is rejected instead of being followed out of bounds.
+ */
+
+#include "fzc.hpp"
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char RESULT_MAGIC[8] = {'F', 'Z', 'C', 'T', 'R', 'E', 'E', '\0'};
+constexpr uint32_t RESULT_VERSION = 2;     // 2: sparseFiles
+constexpr uint32_t RESULT_BYTE_ORDER = 0x01020304;
+
+struct ResultFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;         // RESULT_BYTE_ORDER as written; files are not portable across endianness
+    uint32_t nodeSize;          // sizeof(FileNode) when written
+    uint32_t rootIndex;
+    uint64_t nodeCount;
+    uint64_t stringBytes;
+    uint64_t nodesOffset;
+    uint64_t stringsOffset;
+    double elapsedTimeMs;
+    uint64_t hardLinkSavings;
+    uint64_t truncatedAt;
+    uint64_t reusedDirectories;
+    uint64_t sparseFiles;
+    uint32_t isComplete;
+    int32_t stopReason;
+};
+
+// Every node link inside the array, every name inside the table and NUL-terminated,
+// and each child list made of exactly childCount nodes naming that parent. Together
+// with a parentless root this rules out cycles; the walk is bounded by nodeCount.
+bool validNodes(const FileNode* nodes, uint64_t nodeCount, const char* strings, uint64_t stringBytes, uint32_t rootIndex) {
+    auto linkOk = [nodeCount](NodeIndex index) { return index == INVALID_NODE || index < nodeCount; };
+    if (nodes[rootIndex].parent != INVALID_NODE) return false;
+    uint64_t linked = 0;
+    for (uint64_t index = 0; index < nodeCount; ++index) {
+        const FileNode& node = nodes[index];
+        if (!linkOk(node.parent) || !linkOk(node.firstChild) || !linkOk(node.nextSibling)) return false;
+        if (static_cast<uint64_t>(node.nameOffset) + node.nameLength >= stringBytes ||
+            strings[node.nameOffset + node.nameLength] != '\0') return false;
+        uint32_t children = 0;
+        for (NodeIndex child = node.firstChild; child != INVALID_NODE; child = nodes[child].nextSibling) {
+            if (nodes[child].parent != index || children == node.childCount || ++linked > nodeCount) return false;
+            ++children;
+        }
+        if (children != node.childCount) return false;
+    }
+    return true;
+}
+
+} // namespace
+
+bool FolderSizeResult::save(const std::string& file) const {
+    if (!tree || !rootNode) return false;
+    uint64_t nodeCount = tree->nodeCount();
+
+    ResultFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, RESULT_MAGIC, sizeof(RESULT_MAGIC));
+    header.version = RESULT_VERSION;
+    header.byteOrder = RESULT_BYTE_ORDER;
+    header.nodeSize = sizeof(FileNode);
+    header.rootIndex = rootIndex;
+    header.nodeCount = nodeCount;
+    header.nodesOffset = sizeof(ResultFileHeader);
+    header.stringsOffset = header.nodesOffset + nodeCount * sizeof(FileNode);
+    header.elapsedTimeMs = elapsedTimeMs;
+    header.hardLinkSavings = hardLinkSavings;
+    header.truncatedAt = truncatedAt;
+    header.reusedDirectories = reusedDirectories;
+    header.sparseFiles = sparseFiles;
+    header.isComplete = isComplete;
+    header.stopReason = static_cast<int32_t>(stopReason);
+
+    // The arena leaves gaps at chunk ends; names are repacked into one contiguous table
+    std::string strings;
+    std::string tmpFile = file + ".tmp";
+    std::ofstream out(tmpFile, std::ios::binary | std::ios::trunc);
+    if (!out) return false;
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    std::vector<FileNode> block;
+    block.reserve(4096);
+    bool ok = true;
+    for (uint64_t index = 0; index < nodeCount && ok; ++index) {
+        FileNode node = tree->node(static_cast<NodeIndex>(index));
+        std::string_view name = tree->nameView(node);
+        if (strings.size() + name.size() + 1 > UINT32_MAX) {
+            ok = false;
+            break;
+        }
+        node.nameOffset = static_cast<uint32_t>(strings.size());
+        strings.append(name);
+        strings.push_back('\0');
+        block.push_back(node);
+        if (block.size() == block.capacity() || index + 1 == nodeCount) {
+            out.write(reinterpret_cast<const char*>(block.data()), block.size() * sizeof(FileNode));
+            block.clear();
+        }
+    }
+    out.write(strings.data(), strings.size());
+    // Patch the table size in now that it is known
+    header.stringBytes = strings.size();
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    ok = ok && out.good();
+    out.close();
+    if (!ok || std::rename(tmpFile.c_str(), file.c_str()) != 0) {
+        std::remove(tmpFile.c_str());
+        return false;
+    }
+    return true;
+}
+
+FolderSizeResult FolderSizeResult::load(const std::string& file) {
+    FolderSizeResult failed(nullptr, INVALID_NODE, 0.0);
+    int fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return failed;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(ResultFileHeader)) {
+        close(fd);
+        return failed;
+    }
+    size_t mapSize = static_cast<size_t>(st.st_size);
+    // Private and writable so the tree's non-const accessors stay valid; pages are only copied if written
+    void* map = mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return failed;
+
+    auto* base = static_cast<char*>(map);
+    const auto* header = reinterpret_cast<const ResultFileHeader*>(base);
+    auto fits = [mapSize](uint64_t offset, uint64_t count, uint64_t itemSize) {
+        return offset <= mapSize && count <= (mapSize - offset) / itemSize;
+    };
+    bool valid = std::memcmp(header->magic, RESULT_MAGIC, sizeof(RESULT_MAGIC)) == 0 &&
+                 header->version == RESULT_VERSION && header->byteOrder == RESULT_BYTE_ORDER &&
+                 header->nodeSize == sizeof(FileNode) && header->nodeCount < INVALID_NODE &&
+                 header->rootIndex < header->nodeCount && header->stringBytes > 0 &&
+                 header->stringBytes <= UINT32_MAX &&
+                 header->nodesOffset % alignof(FileNode) == 0 &&
+                 fits(header->nodesOffset, header->nodeCount, sizeof(FileNode)) &&
+                 fits(header->stringsOffset, header->stringBytes, 1) &&
+                 base[header->stringsOffset + header->stringBytes - 1] == '\0' &&
+                 validNodes(reinterpret_cast<const FileNode*>(base + header->nodesOffset), header->nodeCount,
+                            base + header->stringsOffset, header->stringBytes, header->rootIndex);
+    if (!valid) {
+        munmap(map, mapSize);
+        return failed;
+    }
+
+    auto tree = FileTree::fromMapping(map, mapSize, reinterpret_cast<FileNode*>(base + header->nodesOffset),
+                                      static_cast<uint32_t>(header->nodeCount), base + header->stringsOffset,
+                                      header->stringBytes);
+    FolderSizeResult result(std::move(tree), header->rootIndex, header->elapsedTimeMs);
+    result.hardLinkSavings = header->hardLinkSavings;
+    result.isComplete = header->isComplete != 0;
+    result.stopReason = static_cast<StopReason>(header->stopReason);
+    result.truncatedAt = header->truncatedAt;
+    result.reusedDirectories = header->reusedDirectories;
+    result.sparseFiles = header->sparseFiles;
+    return result;
+}
@@ -0,0 +1,224 @@
+/*
+ * fzc_snapshot.cpp
+ *
+ * Reading and writing of persistent scan snapshots (ScanSnapshot).
+ */
+
+#include "fzc_snapshot.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char SNAPSHOT_MAGIC[8] = {'F', 'Z', 'C', 'S', 'N', 'A', 'P', '\0'};
+constexpr uint32_t SNAPSHOT_VERSION = 2;   // 2: st_blocks allocated sizes on Linux, isSparse
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint32_t nodeSize;      // sizeof(SnapshotNode) and sizeof(SnapshotStat) when written,
+    uint32_t recordSize;    // so a layout change is caught instead of misread
+    uint64_t nodeCount;
+    uint64_t recordCount;
+    uint64_t stringBytes;
+    uint64_t nodesOffset;
+    uint64_t recordsOffset;
+    uint64_t stringsOffset;
+};
+
+#ifdef __APPLE__
+inline const struct timespec& modifiedTime(const struct stat& st) { return st.st_mtimespec; }
+inline const struct timespec& changedTime(const struct stat& st) { return st.st_ctimespec; }
+#else
+inline const struct timespec& modifiedTime(const struct stat& st) { return st.st_mtim; }
+inline const struct timespec& changedTime(const struct stat& st) { return st.st_ctim; }
+#endif
+
+} // namespace
+
+SnapshotStat SnapshotStat::fromStat(const struct stat& st, uint64_t fullSize) {
+    SnapshotStat record;
+    record.dev = static_cast<uint64_t>(st.st_dev);
+    record.ino = static_cast<uint64_t>(st.st_ino);
+    record.mtimeSec = static_cast<int64_t>(modifiedTime(st).tv_sec);
+    record.ctimeSec = static_cast<int64_t>(changedTime(st).tv_sec);
+    record.mtimeNsec = static_cast<uint32_t>(modifiedTime(st).tv_nsec);
+    record.ctimeNsec = static_cast<uint32_t>(changedTime(st).tv_nsec);
+    record.fullSize = fullSize;
+    return record;
+}
+
+bool SnapshotStat::matches(const struct stat& st) const {
+    // ctime catches permission and ownership changes that mtime misses
+    return dev == static_cast<uint64_t>(st.st_dev) && ino == static_cast<uint64_t>(st.st_ino) &&
+           mtimeSec == static_cast<int64_t>(modifiedTime(st).tv_sec) &&
+           mtimeNsec == static_cast<uint32_t>(modifiedTime(st).tv_nsec) &&
+           ctimeSec == static_cast<int64_t>(changedTime(st).tv_sec) &&
+           ctimeNsec == static_cast<uint32_t>(changedTime(st).tv_nsec);
+}
+
+std::unique_ptr<ScanSnapshot> ScanSnapshot::open(const std::string& file, const std::string& rootPath, uint32_t flags) {
+    int fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return nullptr;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(SnapshotHeader)) {
+        close(fd);
+        return nullptr;
+    }
+    std::unique_ptr<ScanSnapshot> snapshot(new ScanSnapshot());
+    snapshot->m_mapSize = static_cast<size_t>(st.st_size);
+    void* map = mmap(nullptr, snapshot->m_mapSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return nullptr;
+    snapshot->m_map = map;
+    if (!snapshot->validate(rootPath, flags)) return nullptr;
+    return snapshot;
+}
+
+ScanSnapshot::~ScanSnapshot() {
+    if (m_map) munmap(m_map, m_mapSize);
+}
+
+bool ScanSnapshot::validate(const std::string& rootPath, uint32_t flags) {
+    const auto* base = static_cast<const char*>(m_map);
+    const auto* header = reinterpret_cast<const SnapshotHeader*>(base);
+    if (std::memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 ||
+        header->version != SNAPSHOT_VERSION || header->flags != flags ||
+        header->nodeSize != sizeof(SnapshotNode) || header->recordSize != sizeof(SnapshotStat)) {
+        return false;
+    }
+    // Every section must lie inside the file; sizes are checked before multiplying
+    auto fits = [this](uint64_t offset, uint64_t count, uint64_t itemSize) {
+        return offset <= m_mapSize && count <= (m_mapSize - offset) / itemSize;
+    };
+    if (header->nodeCount == 0 || header->nodeCount >= SNAPSHOT_NO_RECORD ||
+        !fits(header->nodesOffset, header->nodeCount, sizeof(SnapshotNode)) ||
+        !fits(header->recordsOffset, header->recordCount, sizeof(SnapshotStat)) ||
+        !fits(header->stringsOffset, header->stringBytes, 1) ||
+        header->nodesOffset % alignof(SnapshotNode) != 0 || header->recordsOffset % alignof(SnapshotStat) != 0) {
+        return false;
+    }
+    m_nodes = reinterpret_cast<const SnapshotNode*>(base + header->nodesOffset);
+    m_records = reinterpret_cast<const SnapshotStat*>(base + header->recordsOffset);
+    m_strings = base + header->stringsOffset;
+    m_nodeCount = header->nodeCount;
+    m_recordCount = header->recordCount;
+    m_stringBytes = header->stringBytes;
+
+    // One pass over the nodes so lookups during the scan never need bounds checks
+    for (uint64_t i = 0; i < m_nodeCount; ++i) {
+        const SnapshotNode& node = m_nodes[i];
+        if (static_cast<uint64_t>(node.nameOffset) + node.nameLength >= m_stringBytes) return false;
+        if (node.record != SNAPSHOT_NO_RECORD && node.record >= m_recordCount) return false;
+        if (node.childCount > 0 &&
+            (node.firstChild <= i || static_cast<uint64_t>(node.firstChild) + node.childCount > m_nodeCount)) {
+            return false;
+        }
+    }
+    const SnapshotNode& root = m_nodes[ROOT];
+    return root.isDirectory && name(root) == rootPath;
+}
+
+NodeIndex ScanSnapshot::findChild(NodeIndex directory, std::string_view childName) const {
+    const SnapshotNode& parent = m_nodes[directory];
+    uint32_t low = parent.firstChild;
+    uint32_t high = parent.firstChild + parent.childCount;
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        int order = name(m_nodes[mid]).compare(childName);
+        if (order == 0) return mid;
+        if (order < 0) low = mid + 1;
+        else high = mid;
+    }
+    return INVALID_NODE;
+}
+
+bool ScanSnapshot::write(const std::string& file, uint32_t flags, const FileTree& tree, NodeIndex root,
+                         const std::vector<std::pair<NodeIndex, SnapshotStat>>& records) {
+    std::vector<uint32_t> recordOf(tree.nodeCount(), SNAPSHOT_NO_RECORD);
+    for (size_t i = 0; i < records.size(); ++i) {
+        recordOf[records[i].first] = static_cast<uint32_t>(i);
+    }
+
+    // Breadth-first order gives every directory a contiguous range of children
+    std::vector<NodeIndex> order{root};
+    std::vector<SnapshotNode> nodes;
+    std::vector<SnapshotStat> outRecords;
+    std::string strings;
+    std::vector<NodeIndex> children;
+    nodes.reserve(tree.nodeCount());
+    for (size_t i = 0; i < order.size(); ++i) {
+        const FileNode& node = tree.node(order[i]);
+        std::string_view nodeName = tree.nameView(node);
+        if (strings.size() + nodeName.size() + 1 > UINT32_MAX) return false;
+
+        SnapshotNode out;
+        std::memset(&out, 0, sizeof(out));
+        out.size = node.size;
+        out.nameOffset = static_cast<uint32_t>(strings.size());
+        out.nameLength = node.nameLength;
+        out.isDirectory = node.isDirectory;
+        out.isComplete = node.isComplete;
+        out.isSparse = node.isSparse;
+        out.record = SNAPSHOT_NO_RECORD;
+        strings.append(nodeName);
+        strings.push_back('\0');
+        if (recordOf[order[i]] != SNAPSHOT_NO_RECORD) {
+            out.record = static_cast<uint32_t>(outRecords.size());
+            outRecords.push_back(records[recordOf[order[i]]].second);
+        }
+
+        children.clear();
+        for (NodeIndex child = node.firstChild; child != INVALID_NODE; child = tree.node(child).nextSibling) {
+            children.push_back(child);
+        }
+        std::sort(children.begin(), children.end(), [&tree](NodeIndex a, NodeIndex b) {
+            return tree.nameView(tree.node(a)) < tree.nameView(tree.node(b));
+        });
+        out.firstChild = static_cast<uint32_t>(order.size());
+        out.childCount = static_cast<uint32_t>(children.size());
+        order.insert(order.end(), children.begin(), children.end());
+        nodes.push_back(out);
+    }
+
+    SnapshotHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.version = SNAPSHOT_VERSION;
+    header.flags = flags;
+    header.nodeSize = sizeof(SnapshotNode);
+    header.recordSize = sizeof(SnapshotStat);
+    header.nodeCount = nodes.size();
+    header.recordCount = outRecords.size();
+    header.stringBytes = strings.size();
+    header.nodesOffset = sizeof(SnapshotHeader);
+    header.recordsOffset = header.nodesOffset + nodes.size() * sizeof(SnapshotNode);
+    header.stringsOffset = header.recordsOffset + outRecords.size() * sizeof(SnapshotStat);
+
+    // Readers map the file, so it is only ever replaced whole
+    std::string tmpFile = file + ".tmp";
+    {
+        std::ofstream out(tmpFile, std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(nodes.data()), nodes.size() * sizeof(SnapshotNode));
+        out.write(reinterpret_cast<const char*>(outRecords.data()), outRecords.size() * sizeof(SnapshotStat));
+        out.write(strings.data(), strings.size());
+        if (!out.good()) {
+            out.close();
+            std::remove(tmpFile.c_str());
+            return false;
+        }
+    }
+    if (std::rename(tmpFile.c_str(), file.c_str()) != 0) {
+        std::remove(tmpFile.c_str());
+        return false;
+    }
+    return true;
+}
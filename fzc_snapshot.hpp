@@ -0,0 +1,97 @@
+#ifndef FZC_SNAPSHOT_HPP
+#define FZC_SNAPSHOT_HPP
+
+#include "fzc.hpp"
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Persistent snapshot of a completed scan, used to skip unchanged subtrees on
+// the next scan of the same root. The file is a header followed by three flat
+// arrays (nodes, stat records, names) and is mmap'ed read-only as is.
+//
+// Nodes are laid out breadth first: the children of a directory occupy a
+// contiguous index range, sorted by name, and node 0 is the scan root. Every
+// directory, and every file with more than one link, points to a stat record.
+// A directory whose (dev, ino, mtime, ctime) still match its record has the
+// same entries as when the snapshot was written, so its file sizes are taken
+// from the snapshot and only its subdirectories are stat'ed again. Contents
+// rewritten in place (same names, no directory change) are not detected.
+
+constexpr uint32_t SNAPSHOT_NO_RECORD = UINT32_MAX;
+
+// Options that change sizes; a snapshot written with other options is ignored
+enum SnapshotFlags : uint32_t {
+    SNAPSHOT_ALLOCATED_SIZE = 1u << 0,
+    SNAPSHOT_DIRECTORY_SIZE = 1u << 1,
+};
+
+struct SnapshotStat {
+    uint64_t dev;
+    uint64_t ino;
+    int64_t mtimeSec;
+    int64_t ctimeSec;
+    uint32_t mtimeNsec;
+    uint32_t ctimeNsec;
+    uint64_t fullSize;      // size before hard-link dedupe (files only)
+
+    static SnapshotStat fromStat(const struct stat& st, uint64_t fullSize = 0);
+    // True if the entry still has the identity and timestamps recorded here
+    bool matches(const struct stat& st) const;
+};
+
+struct SnapshotNode {
+    uint64_t size;          // aggregated size for directories
+    uint32_t nameOffset;
+    uint32_t firstChild;
+    uint32_t childCount;
+    uint32_t record;        // index into the stat records, or SNAPSHOT_NO_RECORD
+    uint16_t nameLength;
+    uint8_t isDirectory;
+    uint8_t isComplete;
+    uint8_t isSparse;
+    uint8_t reserved[3];
+};
+
+class ScanSnapshot {
+public:
+    // Map and validate a snapshot of rootPath; nullptr if missing, corrupt,
+    // written for another root, or written with other flags
+    static std::unique_ptr<ScanSnapshot> open(const std::string& file, const std::string& rootPath, uint32_t flags);
+
+    // Write the tree under root with its stat records (indexed by NodeIndex).
+    // The file is replaced atomically through a temporary file and rename.
+    static bool write(const std::string& file, uint32_t flags, const FileTree& tree, NodeIndex root,
+                      const std::vector<std::pair<NodeIndex, SnapshotStat>>& records);
+
+    ~ScanSnapshot();
+    ScanSnapshot(const ScanSnapshot&) = delete;
+    ScanSnapshot& operator=(const ScanSnapshot&) = delete;
+
+    static constexpr uint32_t ROOT = 0;
+
+    const SnapshotNode& node(uint32_t index) const { return m_nodes[index]; }
+    const SnapshotStat* record(const SnapshotNode& node) const {
+        return node.record == SNAPSHOT_NO_RECORD ? nullptr : &m_records[node.record];
+    }
+    std::string_view name(const SnapshotNode& node) const { return {m_strings + node.nameOffset, node.nameLength}; }
+
+    // Child of a directory node by name (binary search), or INVALID_NODE
+    NodeIndex findChild(NodeIndex directory, std::string_view name) const;
+
+private:
+    ScanSnapshot() = default;
+    bool validate(const std::string& rootPath, uint32_t flags);
+
+    void* m_map = nullptr;
+    size_t m_mapSize = 0;
+    const SnapshotNode* m_nodes = nullptr;
+    const SnapshotStat* m_records = nullptr;
+    const char* m_strings = nullptr;
+    uint64_t m_nodeCount = 0;
+    uint64_t m_recordCount = 0;
+    uint64_t m_stringBytes = 0;
+};
+
+#endif // FZC_SNAPSHOT_HPP
@@ -0,0 +1,61 @@
+#ifndef FZC_STATS_HPP
+#define FZC_STATS_HPP
+
+#include "fzc.hpp"
+#include <chrono>
+#include <cstdint>
+
+// Compile-time instrumentation of the scan pipeline (FZC_ENABLE_STATS).
+//
+// Every timed operation is wrapped in FZC_STAT_SCOPE(kind[, count]), which
+// adds its count and wall time to the calling thread's StatsBlock. Each scan
+// owns one block per worker slot and binds the current thread to its slot,
+// so recording is a plain add with no atomics and no sharing. Without
+// FZC_ENABLE_STATS the macros expand to nothing and the scan is unchanged.
+
+constexpr int STAT_KIND_COUNT = static_cast<int>(StatKind::Count);
+
+struct alignas(64) StatsBlock {
+    uint64_t count[STAT_KIND_COUNT] = {};
+    uint64_t nanoseconds[STAT_KIND_COUNT] = {};
+};
+
+#ifdef FZC_ENABLE_STATS
+
+// Block of the scan running on this thread, or nullptr outside a scan
+inline thread_local StatsBlock* t_statsBlock = nullptr;
+
+class ScopedStat {
+public:
+    explicit ScopedStat(StatKind kind, uint64_t count = 1)
+        : m_block(t_statsBlock), m_kind(static_cast<int>(kind)), m_count(count) {
+        if (m_block) m_start = std::chrono::steady_clock::now();
+    }
+    ~ScopedStat() {
+        if (!m_block) return;
+        auto elapsed = std::chrono::steady_clock::now() - m_start;
+        m_block->count[m_kind] += m_count;
+        m_block->nanoseconds[m_kind] += static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    }
+    ScopedStat(const ScopedStat&) = delete;
+    ScopedStat& operator=(const ScopedStat&) = delete;
+
+private:
+    StatsBlock* m_block;
+    int m_kind;
+    uint64_t m_count;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+#define FZC_STAT_CONCAT_INNER(a, b) a##b
+#define FZC_STAT_CONCAT(a, b) FZC_STAT_CONCAT_INNER(a, b)
+#define FZC_STAT_SCOPE(...) ScopedStat FZC_STAT_CONCAT(fzcStatScope, __LINE__)(__VA_ARGS__)
+
+#else
+
+#define FZC_STAT_SCOPE(...) ((void)0)
+
+#endif // FZC_ENABLE_STATS
+
+#endif // FZC_STATS_HPP
@@ -0,0 +1,79 @@
+#ifndef FZC_TOPK_HPP
+#define FZC_TOPK_HPP
+
+#include "fzc.hpp"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// Bounded collectors for the K largest files and directories of a scan.
+// Each worker thread owns one slot (a pair of min-heaps), so offers never
+// take a lock; slots are merged once when the scan is done. Paths are only
+// built for entries that beat the slot's current minimum.
+class TopKCollector {
+public:
+    TopKCollector(size_t k, int slotCount) : m_k(k), m_slots(slotCount > 0 ? slotCount : 1) {}
+
+    void offerFile(int slot, const std::string& dirPath, const std::string& name, uint64_t size) {
+        Heap& heap = m_slots[slot].files;
+        if (!accepts(heap, size)) return;
+        std::string path = dirPath;
+        if (path.empty() || path.back() != '/') path += '/';
+        path += name;
+        push(heap, {std::move(path), size});
+    }
+
+    void offerDirectory(int slot, const std::string& path, uint64_t size) {
+        Heap& heap = m_slots[slot].directories;
+        if (!accepts(heap, size)) return;
+        push(heap, {path, size});
+    }
+
+    // Merge all slots into the final lists, largest first
+    std::vector<TopKEntry> takeFiles() { return merge(&Slot::files); }
+    std::vector<TopKEntry> takeDirectories() { return merge(&Slot::directories); }
+
+private:
+    using Heap = std::vector<TopKEntry>;
+
+    struct alignas(64) Slot {
+        Heap files;
+        Heap directories;
+    };
+
+    // Min-heap on size: the front is the smallest entry we still keep
+    static bool greaterSize(const TopKEntry& a, const TopKEntry& b) { return a.size > b.size; }
+
+    bool accepts(const Heap& heap, uint64_t size) const {
+        return m_k > 0 && (heap.size() < m_k || size > heap.front().size);
+    }
+
+    void push(Heap& heap, TopKEntry entry) {
+        if (heap.size() == m_k) {
+            std::pop_heap(heap.begin(), heap.end(), greaterSize);
+            heap.pop_back();
+        }
+        heap.push_back(std::move(entry));
+        std::push_heap(heap.begin(), heap.end(), greaterSize);
+    }
+
+    std::vector<TopKEntry> merge(Heap Slot::*member) {
+        std::vector<TopKEntry> merged;
+        for (auto& slot : m_slots) {
+            auto& heap = slot.*member;
+            std::move(heap.begin(), heap.end(), std::back_inserter(merged));
+            heap.clear();
+        }
+        std::sort(merged.begin(), merged.end(), [](const TopKEntry& a, const TopKEntry& b) {
+            if (a.size != b.size) return a.size > b.size;
+            return a.path < b.path;
+        });
+        if (merged.size() > m_k) merged.resize(m_k);
+        return merged;
+    }
+
+    size_t m_k;
+    std::vector<Slot> m_slots;
+};
+
+#endif // FZC_TOPK_HPP
@@ -0,0 +1,47 @@
+/*
+ * fzc_trace.cpp
+ *
+ * Chrome trace export of scan timelines (TraceRecorder).
+ */
+
+#include "fzc_trace.hpp"
+#include <cinttypes>
+#include <cstdio>
+
+TraceRecorder::TraceRecorder(size_t slots, size_t eventsPerSlot)
+    : m_rings(slots), m_originNs(nowNs()) {
+    // Round up to a power of two so the ring index is a mask
+    size_t capacity = 1;
+    while (capacity < eventsPerSlot) capacity <<= 1;
+    m_mask = capacity - 1;
+    for (Ring& ring : m_rings) ring.events.resize(capacity);
+}
+
+bool TraceRecorder::writeChromeTrace(const std::string& file) const {
+    FILE* out = std::fopen(file.c_str(), "w");
+    if (!out) return false;
+    uint64_t dropped = 0;
+    std::fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    for (size_t slot = 0; slot < m_rings.size(); ++slot) {
+        // The last slot belongs to the thread that started the scan
+        bool isCaller = slot + 1 == m_rings.size();
+        std::fprintf(out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%zu,\"args\":{\"name\":\"%s%s\"}}",
+                     first ? "" : ",\n", slot, isCaller ? "caller" : "worker ",
+                     isCaller ? "" : std::to_string(slot).c_str());
+        first = false;
+
+        const Ring& ring = m_rings[slot];
+        uint64_t capacity = m_mask + 1;
+        uint64_t begin = ring.next > capacity ? ring.next - capacity : 0;
+        dropped += begin;
+        for (uint64_t i = begin; i < ring.next; ++i) {
+            const Event& event = ring.events[i & m_mask];
+            std::fprintf(out, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%zu,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"n\":%" PRIu64 "}}",
+                         event.name, slot, (event.startNs - m_originNs) / 1e3, event.durationNs / 1e3, event.arg);
+        }
+    }
+    std::fprintf(out, "\n],\"otherData\":{\"droppedEvents\":%" PRIu64 "}}\n", dropped);
+    bool ok = std::ferror(out) == 0;
+    return std::fclose(out) == 0 && ok;
+}
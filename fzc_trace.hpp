@@ -0,0 +1,78 @@
+#ifndef FZC_TRACE_HPP
+#define FZC_TRACE_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Timeline of worker activity during one scan, written as Chrome trace JSON
+// (chrome://tracing, ui.perfetto.dev). Every worker slot has its own ring of
+// complete events that only that thread writes, so recording takes no lock;
+// when a ring is full the oldest events are overwritten. Span names must be
+// string literals: events store the pointer, not a copy.
+class TraceRecorder {
+public:
+    static constexpr size_t DEFAULT_EVENTS_PER_SLOT = size_t(1) << 16;
+
+    TraceRecorder(size_t slots, size_t eventsPerSlot = DEFAULT_EVENTS_PER_SLOT);
+
+    static int64_t nowNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void record(int slot, const char* name, int64_t startNs, int64_t endNs, uint64_t arg) {
+        Ring& ring = m_rings[slot];
+        Event& event = ring.events[ring.next++ & m_mask];
+        event.name = name;
+        event.startNs = startNs;
+        event.durationNs = endNs - startNs;
+        event.arg = arg;
+    }
+
+    // Write all retained events; the caller slot is labelled "caller", the others "worker N"
+    bool writeChromeTrace(const std::string& file) const;
+
+private:
+    struct Event {
+        const char* name;
+        int64_t startNs;
+        int64_t durationNs;
+        uint64_t arg;
+    };
+    struct alignas(64) Ring {
+        std::vector<Event> events;
+        uint64_t next = 0;
+    };
+
+    std::vector<Ring> m_rings;
+    uint64_t m_mask;
+    int64_t m_originNs;
+};
+
+// Records one span on a slot's ring when it goes out of scope; does nothing
+// (not even read the clock) when the recorder is null
+class TraceSpan {
+public:
+    TraceSpan(TraceRecorder* recorder, int slot, const char* name)
+        : m_recorder(recorder), m_slot(slot), m_name(name),
+          m_startNs(recorder ? TraceRecorder::nowNs() : 0) {}
+    ~TraceSpan() {
+        if (m_recorder) m_recorder->record(m_slot, m_name, m_startNs, TraceRecorder::nowNs(), m_arg);
+    }
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+    // Number shown with the span (entries listed, batch size, ...)
+    void setArg(uint64_t arg) { m_arg = arg; }
+
+private:
+    TraceRecorder* m_recorder;
+    int m_slot;
+    const char* m_name;
+    int64_t m_startNs;
+    uint64_t m_arg = 0;
+};
+
+#endif // FZC_TRACE_HPP
@@ -0,0 +1,138 @@
+/*
+ * fzc_tree.cpp
+ *
+ * Arena storage for scan results (FileTree).
+ */
+
+#include "fzc.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <type_traits>
+
+FileTree::FileTree() {
+    m_nodeChunks.baseBits = NODE_BASE_BITS;
+    m_stringChunks.baseBits = STRING_BASE_BITS;
+    for (unsigned i = 0; i < MAX_CHUNKS; ++i) {
+        m_nodeChunks.chunks[i].store(nullptr);
+        m_stringChunks.chunks[i].store(nullptr);
+    }
+}
+
+FileTree::~FileTree() {
+    if (m_map) {
+        munmap(m_map, m_mapSize);
+        return;
+    }
+    // Freeing the whole tree is one free() per chunk, independent of node count
+    for (unsigned i = 0; i < MAX_CHUNKS; ++i) {
+        std::free(m_nodeChunks.chunks[i].load());
+        std::free(m_stringChunks.chunks[i].load());
+    }
+}
+
+template <typename T>
+T* FileTree::ensureChunk(ChunkTable<T>& table, unsigned chunk, uint64_t capacity) {
+    if (chunk >= MAX_CHUNKS) throw std::length_error("FileTree capacity exceeded");
+    T* existing = table.chunks[chunk].load(std::memory_order_acquire);
+    if (existing) return existing;
+    // Several workers may race to create the same chunk; the loser frees its copy
+    T* fresh = static_cast<T*>(std::malloc(capacity * sizeof(T)));
+    if (!fresh) throw std::bad_alloc();
+    if (!table.chunks[chunk].compare_exchange_strong(existing, fresh, std::memory_order_acq_rel)) {
+        std::free(fresh);
+        return existing;
+    }
+    AllocationCounter::note(std::is_same_v<T, FileNode> ? MemoryKind::Nodes : MemoryKind::Strings, capacity * sizeof(T));
+    return fresh;
+}
+
+template <typename T>
+void FileTree::mapFlat(ChunkTable<T>& table, T* base, uint64_t count) {
+    // Chunk k starts at flat offset (2^k - 1) * 2^baseBits
+    for (unsigned chunk = 0; chunk < MAX_CHUNKS; ++chunk) {
+        uint64_t start = ((uint64_t(1) << chunk) - 1) << table.baseBits;
+        if (start >= count) break;
+        table.chunks[chunk].store(base + start);
+    }
+}
+
+std::shared_ptr<FileTree> FileTree::fromMapping(void* map, size_t mapSize, FileNode* nodes, uint32_t nodeCount,
+                                                char* strings, uint64_t stringBytes) {
+    auto tree = std::make_shared<FileTree>();
+    tree->m_map = map;
+    tree->m_mapSize = mapSize;
+    mapFlat(tree->m_nodeChunks, nodes, nodeCount);
+    mapFlat(tree->m_stringChunks, strings, stringBytes);
+    tree->m_nodeCount.store(nodeCount);
+    tree->m_stringBytes.store(stringBytes);
+    return tree;
+}
+
+uint32_t FileTree::allocateString(std::string_view value) {
+    uint64_t needed = value.size() + 1;
+    for (;;) {
+        uint64_t offset = m_stringBytes.fetch_add(needed);
+        if (offset + needed > UINT32_MAX) throw std::length_error("FileTree string arena exceeded");
+        unsigned chunk;
+        uint64_t within, capacity;
+        locate(STRING_BASE_BITS, offset, chunk, within, capacity);
+        // Strings never straddle chunks; on overflow the chunk tail is abandoned and we retry
+        if (within + needed > capacity) continue;
+        char* base = ensureChunk(m_stringChunks, chunk, capacity);
+        std::memcpy(base + within, value.data(), value.size());
+        base[within + value.size()] = '\0';
+        return static_cast<uint32_t>(offset);
+    }
+}
+
+NodeIndex FileTree::addNode(std::string_view name, uint64_t size, bool isDirectory) {
+    // Entry names are at most NAME_MAX; only an unusually long root path can hit this
+    if (name.size() > UINT16_MAX) throw std::length_error("FileTree name too long");
+    if (m_map) throw std::logic_error("FileTree mapped from a file cannot grow");
+    NodeIndex index = m_nodeCount.fetch_add(1);
+    if (index == INVALID_NODE) throw std::length_error("FileTree node limit exceeded");
+    unsigned chunk;
+    uint64_t within, capacity;
+    locate(NODE_BASE_BITS, index, chunk, within, capacity);
+    FileNode& node = ensureChunk(m_nodeChunks, chunk, capacity)[within];
+    node.size = size;
+    node.nameOffset = allocateString(name);
+    node.parent = INVALID_NODE;
+    node.firstChild = INVALID_NODE;
+    node.nextSibling = INVALID_NODE;
+    node.childCount = 0;
+    node.nameLength = static_cast<uint16_t>(name.size());
+    node.isDirectory = isDirectory;
+    node.isSparse = false;
+    node.isComplete = true;
+    return index;
+}
+
+void FileTree::setChildren(NodeIndex parent, const NodeIndex* children, size_t count) {
+    FileNode& parentNode = node(parent);
+    parentNode.firstChild = INVALID_NODE;
+    parentNode.childCount = static_cast<uint32_t>(count);
+    // Link back to front so the list ends up in the given order
+    for (size_t i = count; i-- > 0;) {
+        FileNode& child = node(children[i]);
+        child.parent = parent;
+        child.nextSibling = parentNode.firstChild;
+        parentNode.firstChild = children[i];
+    }
+}
+
+std::string FileTree::path(NodeIndex index) const {
+    std::vector<NodeIndex> chain;
+    for (NodeIndex current = index; current != INVALID_NODE; current = node(current).parent) {
+        chain.push_back(current);
+    }
+    std::string result;
+    for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+        if (!result.empty() && result.back() != '/') result += '/';
+        result += nameView(node(*it));
+    }
+    return result;
+}
@@ -0,0 +1,239 @@
+/*
+ * fzc_uring.cpp
+ *
+ * io_uring based batched statx engine for Linux. Falls back cleanly (create()
+ * returns nullptr) when the kernel or sandbox does not allow io_uring.
+ */
+
+#include "fzc_uring.hpp"
+#include "fzc_stats.hpp"
+
+#ifdef __linux__
+#include <algorithm>
+#include <cerrno>
+#include <dirent.h>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+
+namespace {
+
+int ioUringSetup(unsigned entries, struct io_uring_params* params) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int ioUringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+}
+
+int ioUringRegister(int fd, unsigned opcode, void* arg, unsigned nrArgs) {
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, nrArgs));
+}
+
+// Only the fields the traversal reads; atime is left out of the mask on purpose
+constexpr unsigned STATX_MASK = STATX_TYPE | STATX_MODE | STATX_NLINK | STATX_UID | STATX_GID |
+                                STATX_INO | STATX_SIZE | STATX_BLOCKS | STATX_MTIME | STATX_CTIME;
+
+void statxToStat(const struct statx& stx, struct stat& st) {
+    std::memset(&st, 0, sizeof(st));
+    st.st_mode = stx.stx_mode;
+    st.st_nlink = stx.stx_nlink;
+    st.st_uid = stx.stx_uid;
+    st.st_gid = stx.stx_gid;
+    st.st_ino = stx.stx_ino;
+    st.st_size = static_cast<off_t>(stx.stx_size);
+    st.st_blocks = static_cast<blkcnt_t>(stx.stx_blocks);
+    st.st_blksize = stx.stx_blksize;
+    st.st_dev = makedev(stx.stx_dev_major, stx.stx_dev_minor);
+    st.st_mtim.tv_sec = stx.stx_mtime.tv_sec;
+    st.st_mtim.tv_nsec = stx.stx_mtime.tv_nsec;
+    st.st_ctim.tv_sec = stx.stx_ctime.tv_sec;
+    st.st_ctim.tv_nsec = stx.stx_ctime.tv_nsec;
+}
+
+// Entries the synchronous path would skip without a stat (FIFOs, sockets, devices)
+bool needsStat(const DirEntry& entry) {
+    return entry.type == DT_UNKNOWN || entry.type == DT_REG ||
+           entry.type == DT_DIR || entry.type == DT_LNK;
+}
+
+} // namespace
+
+std::unique_ptr<UringStatEngine> UringStatEngine::create(unsigned queueDepth) {
+    std::unique_ptr<UringStatEngine> engine(new UringStatEngine());
+    if (!engine->setup(queueDepth)) return nullptr;
+    return engine;
+}
+
+bool UringStatEngine::setup(unsigned queueDepth) {
+    struct io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    m_ringFd = ioUringSetup(queueDepth, &params);
+    if (m_ringFd < 0) return false;
+
+    // Probe for IORING_OP_STATX support before relying on it
+    size_t probeSize = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    std::vector<unsigned char> probeBuffer(probeSize, 0);
+    auto* probe = reinterpret_cast<struct io_uring_probe*>(probeBuffer.data());
+    if (ioUringRegister(m_ringFd, IORING_REGISTER_PROBE, probe, 256) < 0 ||
+        probe->last_op < IORING_OP_STATX ||
+        !(probe->ops[IORING_OP_STATX].flags & IO_URING_OP_SUPPORTED)) {
+        return false;
+    }
+
+    m_sqEntries = params.sq_entries;
+    m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMmap) {
+        m_sqRingSize = m_cqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+    }
+
+    m_sqRing = mmap(nullptr, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    m_ringFd, IORING_OFF_SQ_RING);
+    if (m_sqRing == MAP_FAILED) {
+        m_sqRing = nullptr;
+        return false;
+    }
+    if (singleMmap) {
+        m_cqRing = m_sqRing;
+    } else {
+        m_cqRing = mmap(nullptr, m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        m_ringFd, IORING_OFF_CQ_RING);
+        if (m_cqRing == MAP_FAILED) {
+            m_cqRing = nullptr;
+            return false;
+        }
+    }
+    m_sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqes = mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      m_ringFd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) return false;
+    m_sqes = static_cast<struct io_uring_sqe*>(sqes);
+
+    auto* sq = static_cast<char*>(m_sqRing);
+    m_sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    m_sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    m_sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    m_sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    auto* cq = static_cast<char*>(m_cqRing);
+    m_cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    m_cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    m_cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    m_cqes = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    m_results.resize(m_sqEntries);
+    return true;
+}
+
+UringStatEngine::~UringStatEngine() {
+    if (m_sqes) munmap(m_sqes, m_sqesSize);
+    if (m_cqRing && m_cqRing != m_sqRing) munmap(m_cqRing, m_cqRingSize);
+    if (m_sqRing) munmap(m_sqRing, m_sqRingSize);
+    if (m_ringFd >= 0) close(m_ringFd);
+}
+
+bool UringStatEngine::submitAndWait(unsigned count) {
+    unsigned submitted = 0;
+    while (submitted < count) {
+        int ret = ioUringEnter(m_ringFd, count - submitted, count - submitted, IORING_ENTER_GETEVENTS);
+        if (ret < 0) {
+            if (errno == EINTR || errno == EAGAIN) continue;
+            return false;
+        }
+        submitted += static_cast<unsigned>(ret);
+        m_inFlight += static_cast<unsigned>(ret);
+    }
+    return true;
+}
+
+// Reap and discard every completion still owed, so nothing writes into m_results later
+bool UringStatEngine::drain() {
+    while (m_inFlight > 0) {
+        unsigned head = *m_cqHead;
+        unsigned cqTail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+        if (head == cqTail) {
+            if (ioUringEnter(m_ringFd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) return false;
+            continue;
+        }
+        unsigned ready = cqTail - head;
+        m_inFlight -= std::min(ready, m_inFlight);
+        __atomic_store_n(m_cqHead, cqTail, __ATOMIC_RELEASE);
+    }
+    return true;
+}
+
+bool UringStatEngine::statEntries(int dirFd, DirEntryList& entries, const std::function<bool()>& keepGoing) {
+    size_t next = 0;
+    std::vector<size_t> inFlight;
+    inFlight.reserve(m_sqEntries);
+    while (next < entries.size()) {
+        // The ring is idle between rounds, so stopping here leaves nothing in flight
+        if (keepGoing && !keepGoing()) break;
+        // Fill the submission queue with up to m_sqEntries statx requests
+        inFlight.clear();
+        unsigned tail = *m_sqTail;
+        while (next < entries.size() && inFlight.size() < m_sqEntries) {
+            DirEntry& entry = entries[next++];
+            if (!needsStat(entry)) continue;
+            unsigned slot = tail & *m_sqMask;
+            struct io_uring_sqe* sqe = &m_sqes[slot];
+            std::memset(sqe, 0, sizeof(*sqe));
+            sqe->opcode = IORING_OP_STATX;
+            sqe->fd = dirFd;
+            sqe->addr = reinterpret_cast<uint64_t>(entry.name.c_str());
+            sqe->len = STATX_MASK;
+            sqe->off = reinterpret_cast<uint64_t>(&m_results[inFlight.size()]);
+            sqe->statx_flags = AT_SYMLINK_NOFOLLOW;
+            sqe->user_data = inFlight.size();
+            m_sqArray[slot] = slot;
+            inFlight.push_back(next - 1);
+            ++tail;
+        }
+        if (inFlight.empty()) break;
+        __atomic_store_n(m_sqTail, tail, __ATOMIC_RELEASE);
+
+        unsigned count = static_cast<unsigned>(inFlight.size());
+        bool submitted;
+        {
+            FZC_STAT_SCOPE(StatKind::Statx, count);
+            submitted = submitAndWait(count);
+        }
+        if (!submitted) {
+            drain();
+            return false;
+        }
+
+        // Reap completions; the wait above guarantees all of them are posted
+        unsigned reaped = 0;
+        unsigned head = *m_cqHead;
+        while (reaped < count) {
+            unsigned cqTail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+            if (head == cqTail) {
+                if (ioUringEnter(m_ringFd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+                    __atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+                    drain();
+                    return false;
+                }
+                continue;
+            }
+            const struct io_uring_cqe& cqe = m_cqes[head & *m_cqMask];
+            size_t index = static_cast<size_t>(cqe.user_data);
+            if (cqe.res == 0 && index < inFlight.size()) {
+                DirEntry& entry = entries[inFlight[index]];
+                statxToStat(m_results[index], entry.st);
+                entry.hasStat = true;
+            }
+            ++head;
+            ++reaped;
+            --m_inFlight;
+        }
+        __atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+    }
+    return true;
+}
+
+#endif // __linux__
@@ -0,0 +1,68 @@
+#ifndef FZC_URING_HPP
+#define FZC_URING_HPP
+
+#include "fzc.hpp"
+#include <functional>
+#include <memory>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+
+// Batched metadata engine on top of io_uring (Linux 5.6+).
+// Each directory's entries are submitted as IORING_OP_STATX requests relative
+// to the directory fd, keeping up to QUEUE_DEPTH stats in flight from a single
+// thread. The ring is driven with raw syscalls, so no liburing is required.
+class UringStatEngine {
+public:
+    static constexpr unsigned QUEUE_DEPTH = 256;
+
+    // Returns nullptr when io_uring or IORING_OP_STATX is unavailable (old kernel, seccomp, sysctl)
+    static std::unique_ptr<UringStatEngine> create(unsigned queueDepth = QUEUE_DEPTH);
+    ~UringStatEngine();
+
+    UringStatEngine(const UringStatEngine&) = delete;
+    UringStatEngine& operator=(const UringStatEngine&) = delete;
+
+    // Stat every sized entry relative to dirFd without following symlinks; fills
+    // DirEntry::st/hasStat. Returns false if the ring failed: entries stat'ed so far
+    // are valid, the rest must be stat'ed by the caller, and the engine must not be
+    // used again (a failed ring can hold completions of this batch). keepGoing is asked
+    // before each submission; when it says stop, the remaining entries are left unstat'ed.
+    bool statEntries(int dirFd, DirEntryList& entries, const std::function<bool()>& keepGoing = {});
+
+    // True when no request is left in flight; a failed engine that is not idle may
+    // still be written to by the kernel and must not be freed
+    bool idle() const { return m_inFlight == 0; }
+
+private:
+    UringStatEngine() = default;
+    bool setup(unsigned queueDepth);
+    bool submitAndWait(unsigned count);
+    bool drain();
+
+    int m_ringFd = -1;
+    unsigned m_sqEntries = 0;
+    void* m_sqRing = nullptr;
+    void* m_cqRing = nullptr;
+    size_t m_sqRingSize = 0;
+    size_t m_cqRingSize = 0;
+    struct io_uring_sqe* m_sqes = nullptr;
+    size_t m_sqesSize = 0;
+
+    unsigned* m_sqHead = nullptr;
+    unsigned* m_sqTail = nullptr;
+    unsigned* m_sqMask = nullptr;
+    unsigned* m_sqArray = nullptr;
+    unsigned* m_cqHead = nullptr;
+    unsigned* m_cqTail = nullptr;
+    unsigned* m_cqMask = nullptr;
+    struct io_uring_cqe* m_cqes = nullptr;
+
+    unsigned m_inFlight = 0;    // requests taken by the kernel and not yet reaped
+    std::vector<struct statx> m_results;
+};
+
+#endif // __linux__
+
+#endif // FZC_URING_HPP
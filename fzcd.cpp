@@ -0,0 +1,624 @@
+/*
+ * fzcd.cpp
+ *
+ * Incremental size daemon (Linux). Does one full scan with FZC, then keeps
+ * every directory's aggregated size current from recursive inotify watches,
+ * propagating each change up the parent chain. Sizes are served over a local
+ * Unix socket with a line protocol:
+ *
+ *   SIZE <absolute path>   ->  OK <bytes>  |  ERR <reason>
+ *   STATS                  ->  OK <root bytes> <directories> <files>
+ *
+ * Notes:
+ * - Every directory is watched when the scan enters it, before it is
+ *   listed, so changes made after the listing are never missed; events that
+ *   repeat what the listing already saw are applied idempotently.
+ * - New directories are scanned with FZC when they appear; a removed
+ *   directory subtracts its whole subtree.
+ * - Sizes of files changed after the initial scan come from lstat; hard links
+ *   changed later are counted once per link.
+ * - A kernel event queue overflow triggers a full rescan.
+ */
+
+#include "fzc.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+volatile sig_atomic_t g_stop = 0;
+
+void handleStopSignal(int) {
+    g_stop = 1;
+}
+
+constexpr uint32_t WATCH_MASK = IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB |
+                                IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF |
+                                IN_ONLYDIR | IN_DONT_FOLLOW | IN_EXCL_UNLINK;
+
+std::string joinPath(const std::string& parent, const std::string& name) {
+    if (!parent.empty() && parent.back() == '/') return parent + name;
+    return parent + "/" + name;
+}
+
+// Streams one FZC scan into per-directory totals and file sizes. Each directory
+// is watched in onEnter, which the scan calls before listing it, so anything
+// changed after the listing has an event. Callbacks come from the scan's workers.
+class SubtreeCollector : public ScanVisitor {
+public:
+    struct Directory {
+        int wd = -1;
+        int watchError = 0;
+        uint64_t total = 0;
+        std::unordered_map<std::string, uint64_t> files;
+    };
+
+    explicit SubtreeCollector(int inotifyFd) : m_inotifyFd(inotifyFd) {}
+
+    void onEnter(const std::string& path) override {
+        int wd = inotify_add_watch(m_inotifyFd, path.c_str(), WATCH_MASK);
+        int error = wd < 0 ? errno : 0;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Directory& directory = m_directories[path];
+        directory.wd = wd;
+        directory.watchError = error;
+    }
+    void onFile(const std::string& dirPath, const std::string& name, uint64_t size) override {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_directories[dirPath].files[name] = size;
+    }
+    void onLeave(const std::string& path, uint64_t dirTotal) override {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_directories[path].total = dirTotal;
+    }
+
+    // Only read once the scan has returned
+    std::unordered_map<std::string, Directory>& directories() { return m_directories; }
+
+private:
+    int m_inotifyFd;
+    std::mutex m_mutex;
+    std::unordered_map<std::string, Directory> m_directories;
+};
+
+// Aggregated sizes of a watched tree, kept current from inotify events
+class SizeIndex {
+public:
+    SizeIndex(FZC& calculator, std::string root, bool useAllocatedSize, bool includeDirectorySize)
+        : m_calculator(calculator), m_root(std::move(root)), m_useAllocatedSize(useAllocatedSize),
+          m_includeDirectorySize(includeDirectorySize) {}
+
+    ~SizeIndex() {
+        if (m_inotifyFd >= 0) close(m_inotifyFd);
+    }
+
+    bool start() {
+        m_inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (m_inotifyFd < 0) {
+            std::cerr << "inotify_init1 failed: " << strerror(errno) << "\n";
+            return false;
+        }
+        return rescan();
+    }
+
+    int inotifyFd() const { return m_inotifyFd; }
+
+    // Drain pending events and apply them; returns false on a fatal error
+    bool processEvents() {
+        alignas(struct inotify_event) char buffer[64 * 1024];
+        for (;;) {
+            ssize_t length = read(m_inotifyFd, buffer, sizeof(buffer));
+            if (length < 0) {
+                if (errno == EAGAIN || errno == EINTR) return true;
+                std::cerr << "inotify read failed: " << strerror(errno) << "\n";
+                return false;
+            }
+            for (char* cursor = buffer; cursor < buffer + length;) {
+                auto* event = reinterpret_cast<struct inotify_event*>(cursor);
+                cursor += sizeof(struct inotify_event) + event->len;
+                if (event->mask & IN_Q_OVERFLOW) {
+                    // Events were dropped; nothing short of a rescan is trustworthy
+                    std::cerr << "inotify queue overflow, rescanning " << m_root << "\n";
+                    if (!rescan()) return false;
+                    break;
+                }
+                handleEvent(*event);
+            }
+        }
+    }
+
+    // Size of a directory or file under the root; false if it is not tracked
+    bool lookup(const std::string& path, uint64_t& size) const {
+        std::string key = path;
+        while (key.size() > 1 && key.back() == '/') key.pop_back();
+        auto dir = m_pathToDir.find(key);
+        if (dir != m_pathToDir.end()) {
+            size = m_dirs[dir->second].total;
+            return true;
+        }
+        size_t slash = key.rfind('/');
+        if (slash == std::string::npos) return false;
+        std::string parent = slash == 0 ? "/" : key.substr(0, slash);
+        auto parentDir = m_pathToDir.find(parent);
+        if (parentDir == m_pathToDir.end()) return false;
+        const auto& files = m_dirs[parentDir->second].files;
+        auto file = files.find(key.substr(slash + 1));
+        if (file == files.end()) return false;
+        size = file->second;
+        return true;
+    }
+
+    uint64_t rootSize() const { return m_rootDir >= 0 ? m_dirs[m_rootDir].total : 0; }
+    size_t directoryCount() const { return m_pathToDir.size(); }
+    size_t fileCount() const { return m_fileCount; }
+
+private:
+    struct WatchedDir {
+        std::string path;
+        int parent = -1;
+        int wd = -1;
+        bool alive = true;
+        uint64_t ownSize = 0;   // the directory entry itself
+        uint64_t total = 0;     // ownSize + all files and subdirectories below
+        std::unordered_map<std::string, uint64_t> files;
+        std::unordered_map<std::string, int> subdirs;
+    };
+
+    // Throw everything away and build the index from a fresh full scan
+    bool rescan() {
+        for (const auto& dir : m_dirs) {
+            if (dir.alive && dir.wd >= 0) inotify_rm_watch(m_inotifyFd, dir.wd);
+        }
+        m_dirs.clear();
+        m_freeDirs.clear();
+        m_wdToDir.clear();
+        m_pathToDir.clear();
+        m_fileCount = 0;
+        m_rootDir = scanSubtree(m_root, -1);
+        if (m_rootDir < 0) {
+            std::cerr << "Error: could not scan " << m_root << "\n";
+            return false;
+        }
+        return true;
+    }
+
+    // Scan path with FZC and add it under parent; returns the new directory index or -1
+    int scanSubtree(const std::string& path, int parent) {
+        SubtreeCollector collector(m_inotifyFd);
+        ScanSummary summary = m_calculator.scan(path, collector);
+        auto& scanned = collector.directories();
+        if (summary.cancelled || !scanned.count(path)) {
+            // Not a directory (or gone): drop whatever was watched on the way
+            for (const auto& entry : scanned) {
+                if (entry.second.wd >= 0) inotify_rm_watch(m_inotifyFd, entry.second.wd);
+            }
+            return -1;
+        }
+
+        // A parent path is always shorter than its children's, so parents are added first
+        std::vector<std::pair<const std::string*, SubtreeCollector::Directory*>> order;
+        order.reserve(scanned.size());
+        for (auto& entry : scanned) order.emplace_back(&entry.first, &entry.second);
+        std::sort(order.begin(), order.end(), [](const auto& a, const auto& b) { return a.first->size() < b.first->size(); });
+
+        std::vector<int> added;
+        added.reserve(order.size());
+        for (auto& [dirPath, scannedDir] : order) {
+            int parentIndex = parent;
+            std::string name;
+            if (*dirPath != path) {
+                size_t slash = dirPath->rfind('/');
+                auto parentDir = m_pathToDir.find(slash == 0 ? "/" : dirPath->substr(0, slash));
+                if (slash == std::string::npos || parentDir == m_pathToDir.end()) {
+                    if (scannedDir->wd >= 0) inotify_rm_watch(m_inotifyFd, scannedDir->wd);
+                    continue;
+                }
+                parentIndex = parentDir->second;
+                name = dirPath->substr(slash + 1);
+            }
+            int dirIndex = allocateDir();
+            WatchedDir& dir = m_dirs[dirIndex];
+            dir.path = *dirPath;
+            dir.parent = parentIndex;
+            dir.total = scannedDir->total;
+            dir.files = std::move(scannedDir->files);
+            m_fileCount += dir.files.size();
+            m_pathToDir[dir.path] = dirIndex;
+            if (scannedDir->wd >= 0) {
+                dir.wd = scannedDir->wd;
+                m_wdToDir[dir.wd] = dirIndex;
+            } else {
+                reportWatchError(dir.path, scannedDir->watchError);
+            }
+            if (*dirPath != path) m_dirs[parentIndex].subdirs[name] = dirIndex;
+            added.push_back(dirIndex);
+        }
+
+        // The directory entry itself is what its total has on top of its children
+        for (int dirIndex : added) {
+            WatchedDir& dir = m_dirs[dirIndex];
+            uint64_t childrenTotal = 0;
+            for (const auto& file : dir.files) childrenTotal += file.second;
+            for (const auto& subdir : dir.subdirs) childrenTotal += m_dirs[subdir.second].total;
+            dir.ownSize = dir.total > childrenTotal ? dir.total - childrenTotal : 0;
+        }
+        return m_pathToDir[path];
+    }
+
+    // Slot for a new directory; slots freed by dropSubtree are reused, so churn does not grow m_dirs
+    int allocateDir() {
+        if (!m_freeDirs.empty()) {
+            int dirIndex = m_freeDirs.back();
+            m_freeDirs.pop_back();
+            m_dirs[dirIndex] = WatchedDir();
+            return dirIndex;
+        }
+        m_dirs.emplace_back();
+        return static_cast<int>(m_dirs.size()) - 1;
+    }
+
+    void reportWatchError(const std::string& path, int error) {
+        // Usually fs.inotify.max_user_watches; the size stays correct until this subtree changes
+        if (!m_watchLimitReported) {
+            std::cerr << "inotify_add_watch failed on " << path << ": " << strerror(error) << "\n";
+            m_watchLimitReported = error == ENOSPC;
+        }
+    }
+
+    void propagate(int dirIndex, int64_t delta) {
+        if (delta == 0) return;
+        for (int current = dirIndex; current >= 0; current = m_dirs[current].parent) {
+            m_dirs[current].total = static_cast<uint64_t>(static_cast<int64_t>(m_dirs[current].total) + delta);
+        }
+    }
+
+    void handleEvent(const struct inotify_event& event) {
+        auto found = m_wdToDir.find(event.wd);
+        if (found == m_wdToDir.end()) return;
+        int dirIndex = found->second;
+        if (event.mask & IN_IGNORED) {
+            // The watch is gone (directory removed or unmounted); the parent's IN_DELETE did the accounting
+            m_wdToDir.erase(found);
+            m_dirs[dirIndex].wd = -1;
+            return;
+        }
+        if (event.len == 0) return;
+        std::string name = event.name;
+        bool isDir = (event.mask & IN_ISDIR) != 0;
+
+        if (event.mask & (IN_DELETE | IN_MOVED_FROM)) {
+            if (isDir) removeDirectory(dirIndex, name);
+            else removeFile(dirIndex, name);
+        } else if (event.mask & (IN_CREATE | IN_MOVED_TO)) {
+            if (isDir) addDirectory(dirIndex, name);
+            else updateFile(dirIndex, name);
+        } else if (!isDir && (event.mask & (IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB))) {
+            updateFile(dirIndex, name);
+        }
+        if (event.mask & (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO)) {
+            refreshOwnSize(dirIndex);
+        }
+    }
+
+    void updateFile(int dirIndex, const std::string& name) {
+        struct stat st;
+        std::string path = joinPath(m_dirs[dirIndex].path, name);
+        if (lstat(path.c_str(), &st) != 0) {
+            removeFile(dirIndex, name);
+            return;
+        }
+        if (S_ISDIR(st.st_mode)) {
+            addDirectory(dirIndex, name);
+            return;
+        }
+        if (!S_ISREG(st.st_mode) && !S_ISLNK(st.st_mode)) return;
+        uint64_t size = entrySize(st);
+        auto& files = m_dirs[dirIndex].files;
+        auto file = files.find(name);
+        int64_t delta = static_cast<int64_t>(size);
+        if (file == files.end()) {
+            files.emplace(name, size);
+            ++m_fileCount;
+        } else {
+            delta -= static_cast<int64_t>(file->second);
+            file->second = size;
+        }
+        propagate(dirIndex, delta);
+    }
+
+    void removeFile(int dirIndex, const std::string& name) {
+        auto& files = m_dirs[dirIndex].files;
+        auto file = files.find(name);
+        if (file == files.end()) return;
+        int64_t delta = -static_cast<int64_t>(file->second);
+        files.erase(file);
+        --m_fileCount;
+        propagate(dirIndex, delta);
+    }
+
+    void addDirectory(int dirIndex, const std::string& name) {
+        if (m_dirs[dirIndex].subdirs.count(name)) return;
+        std::string path = joinPath(m_dirs[dirIndex].path, name);
+        int childIndex = scanSubtree(path, dirIndex);
+        if (childIndex < 0) return;
+        m_dirs[dirIndex].subdirs[name] = childIndex;
+        propagate(dirIndex, static_cast<int64_t>(m_dirs[childIndex].total));
+    }
+
+    void removeDirectory(int dirIndex, const std::string& name) {
+        auto& subdirs = m_dirs[dirIndex].subdirs;
+        auto subdir = subdirs.find(name);
+        if (subdir == subdirs.end()) return;
+        int childIndex = subdir->second;
+        subdirs.erase(subdir);
+        int64_t delta = -static_cast<int64_t>(m_dirs[childIndex].total);
+        dropSubtree(childIndex);
+        propagate(dirIndex, delta);
+    }
+
+    // Forget a subtree; its slots are marked dead and go to the free list, other indices stay stable
+    void dropSubtree(int dirIndex) {
+        std::vector<int> pending{dirIndex};
+        while (!pending.empty()) {
+            int current = pending.back();
+            pending.pop_back();
+            WatchedDir& dir = m_dirs[current];
+            for (const auto& subdir : dir.subdirs) pending.push_back(subdir.second);
+            if (dir.wd >= 0) {
+                inotify_rm_watch(m_inotifyFd, dir.wd);
+                m_wdToDir.erase(dir.wd);
+            }
+            m_pathToDir.erase(dir.path);
+            m_fileCount -= dir.files.size();
+            dir.alive = false;
+            dir.wd = -1;
+            dir.files.clear();
+            dir.subdirs.clear();
+            m_freeDirs.push_back(current);
+        }
+    }
+
+    // Creating or removing entries changes a directory's own allocated size
+    void refreshOwnSize(int dirIndex) {
+        if (!m_includeDirectorySize) return;
+        struct stat st;
+        WatchedDir& dir = m_dirs[dirIndex];
+        if (lstat(dir.path.c_str(), &st) != 0) return;
+        uint64_t size = entrySize(st);
+        int64_t delta = static_cast<int64_t>(size) - static_cast<int64_t>(dir.ownSize);
+        dir.ownSize = size;
+        propagate(dirIndex, delta);
+    }
+
+    // Size of one entry as the scan counts it: its allocation (as du) or its apparent size
+    uint64_t entrySize(const struct stat& st) const {
+        if (m_useAllocatedSize) return static_cast<uint64_t>(st.st_blocks) * 512;
+        return static_cast<uint64_t>(st.st_size);
+    }
+
+    FZC& m_calculator;
+    std::string m_root;
+    bool m_useAllocatedSize;
+    bool m_includeDirectorySize;
+    int m_inotifyFd = -1;
+    int m_rootDir = -1;
+    size_t m_fileCount = 0;
+    bool m_watchLimitReported = false;
+    std::vector<WatchedDir> m_dirs;
+    std::vector<int> m_freeDirs;        // dead slots of m_dirs, reused by allocateDir
+    std::unordered_map<int, int> m_wdToDir;
+    std::unordered_map<std::string, int> m_pathToDir;
+};
+
+// Answer one protocol line
+std::string answer(const SizeIndex& index, const std::string& line) {
+    if (line.compare(0, 5, "SIZE ") == 0) {
+        uint64_t size = 0;
+        if (!index.lookup(line.substr(5), size)) return "ERR not found\n";
+        return "OK " + std::to_string(size) + "\n";
+    }
+    if (line == "STATS") {
+        return "OK " + std::to_string(index.rootSize()) + " " + std::to_string(index.directoryCount()) +
+               " " + std::to_string(index.fileCount()) + "\n";
+    }
+    return "ERR unknown command\n";
+}
+
+int listenOn(const std::string& socketPath) {
+    struct sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Error: socket path too long: " << socketPath << "\n";
+        return -1;
+    }
+    std::strcpy(address.sun_path, socketPath.c_str());
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    unlink(socketPath.c_str());
+    if (bind(fd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) != 0 || listen(fd, 64) != 0) {
+        std::cerr << "Error: cannot listen on " << socketPath << ": " << strerror(errno) << "\n";
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Client mode: send one SIZE query to a running daemon and print the reply
+int query(const std::string& socketPath, const std::string& path) {
+    struct sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path)) return 1;
+    std::strcpy(address.sun_path, socketPath.c_str());
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) != 0) {
+        std::cerr << "Error: cannot connect to " << socketPath << ": " << strerror(errno) << "\n";
+        if (fd >= 0) close(fd);
+        return 1;
+    }
+    // The daemon keys everything by absolute, resolved path
+    char resolved[PATH_MAX];
+    std::string request = "SIZE " + std::string(realpath(path.c_str(), resolved) ? resolved : path.c_str()) + "\n";
+    if (write(fd, request.data(), request.size()) != static_cast<ssize_t>(request.size())) {
+        close(fd);
+        return 1;
+    }
+    std::string reply;
+    char buffer[256];
+    ssize_t length;
+    while (reply.find('\n') == std::string::npos && (length = read(fd, buffer, sizeof(buffer))) > 0) {
+        reply.append(buffer, static_cast<size_t>(length));
+    }
+    close(fd);
+    std::cout << reply;
+    return reply.compare(0, 3, "OK ") == 0 ? 0 : 1;
+}
+
+void printUsage() {
+    std::cout << "Usage: fzcd [options] <directory_path>\n"
+              << "       fzcd [--socket PATH] --query <path>\n"
+              << "Options:\n"
+              << "  --socket PATH      Unix socket to serve on (default: /tmp/fzcd.sock)\n"
+              << "  --query PATH       Ask a running daemon for the size of PATH\n"
+              << "  -j, --threads N    Threads for full scans (default: auto)\n"
+              << "  --allocated-size=0|1, --include-directory-size=0|1  As for fzc_cli\n"
+              << "  -h, --help         Display this help message\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::string root;
+    std::string socketPath = "/tmp/fzcd.sock";
+    std::string queryPath;
+    int maxThreads = 0;
+    bool useAllocatedSize = true;
+    bool includeDirectorySize = true;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            printUsage();
+            return 0;
+        } else if (arg == "--socket" && i + 1 < argc) {
+            socketPath = argv[++i];
+        } else if (arg == "--query" && i + 1 < argc) {
+            queryPath = argv[++i];
+        } else if ((arg == "-j" || arg == "--threads") && i + 1 < argc) {
+            const char* value = argv[++i];
+            char* end = nullptr;
+            errno = 0;
+            long threads = std::strtol(value, &end, 10);
+            if (end == value || *end != '\0' || errno != 0 || threads < 1 || threads > INT_MAX) {
+                std::cerr << "Error: Invalid thread count: " << value << "\n";
+                printUsage();
+                return 1;
+            }
+            maxThreads = static_cast<int>(threads);
+        } else if (arg.find("--allocated-size=") == 0) {
+            useAllocatedSize = (arg.substr(17) != "0");
+        } else if (arg.find("--include-directory-size=") == 0) {
+            includeDirectorySize = (arg.substr(25) != "0");
+        } else if (arg[0] == '-') {
+            std::cerr << "Unknown option: " << arg << "\n";
+            printUsage();
+            return 1;
+        } else {
+            root = arg;
+        }
+    }
+    if (!queryPath.empty()) return query(socketPath, queryPath);
+    if (root.empty()) {
+        printUsage();
+        return 1;
+    }
+    // Events and queries name absolute paths; a relative or symlinked root would never match them
+    char resolvedRoot[PATH_MAX];
+    if (!realpath(root.c_str(), resolvedRoot)) {
+        std::cerr << "Error: cannot resolve " << root << ": " << strerror(errno) << "\n";
+        return 1;
+    }
+    root = resolvedRoot;
+
+    FZC calculator(true, maxThreads, useAllocatedSize, includeDirectorySize);
+    SizeIndex index(calculator, root, useAllocatedSize, includeDirectorySize);
+    if (!index.start()) return 1;
+    int listenFd = listenOn(socketPath);
+    if (listenFd < 0) return 1;
+    std::cerr << "fzcd: watching " << root << " (" << index.directoryCount() << " directories, "
+              << index.rootSize() << " bytes), serving " << socketPath << "\n";
+
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = handleStopSignal;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+    signal(SIGPIPE, SIG_IGN);
+
+    // One thread does everything: events are applied between queries, so lookups need no locks
+    struct Client {
+        int fd;
+        std::string pending;
+    };
+    std::vector<Client> clients;
+    while (!g_stop) {
+        std::vector<struct pollfd> fds;
+        fds.push_back({index.inotifyFd(), POLLIN, 0});
+        fds.push_back({listenFd, POLLIN, 0});
+        for (const auto& client : clients) fds.push_back({client.fd, POLLIN, 0});
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if ((fds[0].revents & POLLIN) && !index.processEvents()) break;
+        if (fds[1].revents & POLLIN) {
+            int clientFd;
+            while ((clientFd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+                clients.push_back({clientFd, {}});
+            }
+        }
+        for (size_t i = 0; i < clients.size(); ++i) {
+            if (!(fds[i + 2].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            Client& client = clients[i];
+            char buffer[4096];
+            ssize_t length = read(client.fd, buffer, sizeof(buffer));
+            if (length <= 0) {
+                if (length < 0 && (errno == EAGAIN || errno == EINTR)) continue;
+                close(client.fd);
+                client.fd = -1;
+                continue;
+            }
+            client.pending.append(buffer, static_cast<size_t>(length));
+            size_t newline;
+            while ((newline = client.pending.find('\n')) != std::string::npos) {
+                std::string reply = answer(index, client.pending.substr(0, newline));
+                client.pending.erase(0, newline + 1);
+                if (write(client.fd, reply.data(), reply.size()) < 0) break;
+            }
+        }
+        clients.erase(std::remove_if(clients.begin(), clients.end(), [](const Client& client) { return client.fd < 0; }),
+                      clients.end());
+    }
+
+    for (const auto& client : clients) close(client.fd);
+    close(listenFd);
+    unlink(socketPath.c_str());
+    return 0;
+}
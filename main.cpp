@@ -4,6 +4,21 @@
 #include <string>
 #include <sstream>
 #include <cstring>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdlib>
+#include <new>
+
+// Counting allocator hook: every operator new of the process is passed to the
+// memory report of the scan running on the calling thread (no-op otherwise)
+void* operator new(std::size_t size) {
+    AllocationCounter::noteOperatorNew(size);
+    if (void* pointer = std::malloc(size ? size : 1)) return pointer;
+    throw std::bad_alloc();
+}
+void operator delete(void* pointer) noexcept { std::free(pointer); }
+void operator delete(void* pointer, std::size_t) noexcept { std::free(pointer); }
 
 // Helper function to format file size
 std::string formatSize(uint64_t size) {
@@ -22,23 +37,71 @@ std::string formatSize(uint64_t size) {
 }
 
 // Helper function to print the tree
-void printTree(const std::shared_ptr<FileNode>& node, int level = 0) {
-    if (!node) return;
+void printTree(const FileTree& tree, NodeIndex index, int level = 0) {
+    if (index == INVALID_NODE) return;
+    const FileNode& node = tree.node(index);
     
     // Print indentation
     std::string indent(level * 2, ' ');
     
     // Print node info
-    std::cout << indent << node->path << " (" 
-              << (node->isDirectory ? "dir" : "file") << ", " 
-              << formatSize(node->size) << ")" << std::endl;
+    std::cout << indent << tree.name(node) << " (" 
+              << (node.isDirectory ? "dir" : "file") << ", " 
+              << formatSize(node.size) << ")" << std::endl;
     
     // Print children
-    for (const auto& child : node->children) {
-        printTree(child, level + 1);
+    for (NodeIndex child = node.firstChild; child != INVALID_NODE; child = tree.node(child).nextSibling) {
+        printTree(tree, child, level + 1);
     }
 }
 
+// Prints live scan counters to stderr on one line until stopped
+class ProgressPrinter {
+public:
+    explicit ProgressPrinter(const ScanProgress& progress)
+        : m_progress(progress), m_thread([this] { run(); }) {}
+    ~ProgressPrinter() { stop(); }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_stopped) return;
+            m_stopped = true;
+        }
+        m_cv.notify_one();
+        m_thread.join();
+        printLine();
+        std::cerr << "\n";
+    }
+
+private:
+    void run() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (!m_cv.wait_for(lock, std::chrono::milliseconds(250), [this] { return m_stopped; })) {
+            printLine();
+        }
+    }
+
+    void printLine() {
+        std::ostringstream line;
+        line << "\r" << m_progress.entries() << " entries, " << formatSize(m_progress.bytes())
+             << ", dirs " << m_progress.directoriesCompleted() << " done / " << m_progress.directoriesPending() << " pending, "
+             << static_cast<uint64_t>(m_progress.entriesPerSecond()) << " entries/s, "
+             << m_progress.errors() << " errors";
+        // Nothing advanced for a while: most likely blocked on a slow or hung filesystem
+        double idleMs = m_progress.idleMs();
+        if (idleMs >= 5000.0) line << ", stalled " << static_cast<int>(idleMs / 1000.0) << "s";
+        line << "\033[K";
+        std::cerr << line.str() << std::flush;
+    }
+
+    const ScanProgress& m_progress;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_stopped = false;
+    std::thread m_thread;
+};
+
 // Print usage information
 void printUsage() {
     std::cout << "Usage: fzc_cli [options] <directory_path>\n"
@@ -47,20 +110,132 @@ void printUsage() {
               << "  -s, --sequential   Use sequential processing (disable parallel processing)\n"
               << "  -j, --threads N    Specify maximum number of threads to use (default: auto)\n"
               << "  -r, --root-only    Only calculate the size of the root directory\n"
+              << "  -u, --io-uring     Batch metadata reads through io_uring (Linux, falls back if unavailable)\n"
+              << "  -x, --one-file-system  Do not descend into directories on other filesystems\n"
+              << "  --allocated-size=0|1  Count disk usage as du does (default) or apparent sizes (0)\n"
+              << "  --top N            List only the N largest files and directories (no full tree)\n"
+              << "  --progress         Show live progress (entries, bytes, directories, rate) on stderr\n"
+              << "  --snapshot FILE    Reuse unchanged directories from FILE and refresh it after the scan\n"
+              << "  --save FILE        Write the result to FILE in the binary result format\n"
+              << "  --load FILE        Show a result saved with --save instead of scanning (no directory needed)\n"
+              << "  --diff FILE        Show what changed since the result saved in FILE, largest change first\n"
+              << "  --diff-limit N     Number of changes listed by --diff (default: 50, 0 for all)\n"
+              << "  --deadline MS      Stop after MS milliseconds and report the partial result\n"
+              << "  --max-entries N    Stop after about N entries and report the partial result\n"
+              << "  --max-syscalls N   Stop after about N metadata syscalls and report the partial result\n"
+              << "  --trace FILE       Write a Chrome trace (chrome://tracing, Perfetto) of worker activity to FILE\n"
+              << "  --stats            Print per-operation counts and times (needs a build with FZC_ENABLE_STATS)\n"
+              << "  --mem-report       Print allocations by structure and scan phase, and the process peak RSS\n"
               << "  -h, --help         Display this help message\n";
 }
 
-void printNode(const std::shared_ptr<FileNode>& node, int level = 0, bool timeOnly = false) {
+// Nodes only store their names; the full path is carried down the recursion
+void printNode(const FileTree& tree, NodeIndex index, const std::string& path, int level = 0, bool timeOnly = false) {
     if (timeOnly) return;
     
+    const FileNode& node = tree.node(index);
     std::string indent(level * 2, ' ');
-    std::cout << indent << node->path << " (" << node->size << " bytes)\n";
+    std::cout << indent << path << " (" << node.size << " bytes)" << (node.isComplete ? "" : " [incomplete]")
+              << (node.isSparse ? " [sparse]" : "") << "\n";
     
-    for (const auto& child : node->children) {
-        printNode(child, level + 1, timeOnly);
+    std::string prefix = path;
+    if (prefix.empty() || prefix.back() != '/') prefix += '/';
+    for (NodeIndex child = node.firstChild; child != INVALID_NODE; child = tree.node(child).nextSibling) {
+        printNode(tree, child, prefix + tree.name(tree.node(child)), level + 1, timeOnly);
+    }
+}
+
+// Print one top-K list, largest first
+void printTopK(const char* title, const std::vector<TopKEntry>& entries) {
+    std::cout << title << ":\n";
+    for (const auto& entry : entries) {
+        std::cout << "  " << entry.path << " (" << entry.size << " bytes)\n";
+    }
+}
+
+// Print the changes between two results, largest first
+void printDiff(const ResultDiff& diff) {
+    static const char* kindNames[] = {"added", "removed", "grown", "shrunk"};
+    std::cout << "Changes (largest first):\n";
+    for (const auto& entry : diff.entries) {
+        int64_t delta = entry.delta();
+        std::string change = (delta < 0 ? "-" : "+") + formatSize(static_cast<uint64_t>(delta < 0 ? -delta : delta));
+        std::cout << "  " << std::setw(12) << change
+                  << "  " << std::left << std::setw(8) << kindNames[static_cast<int>(entry.kind)] << std::right
+                  << entry.path << (entry.isDirectory ? "/" : "") << "\n";
+    }
+    std::cout << "\nTotal change: " << diff.totalDelta << " bytes\n"
+              << "Directories compared: " << diff.comparedDirectories << ", identical subtrees skipped: " << diff.prunedDirectories << "\n"
+              << "Diff time: " << diff.elapsedTimeMs << " ms\n";
+}
+
+// Print the instrumentation of a scan, one line per operation class
+void printStats(const ScanStats& stats) {
+    if (!stats.enabled) {
+        std::cout << "Statistics not collected: rebuild with -DFZC_ENABLE_STATS=ON\n";
+        return;
+    }
+    std::cout << "Operation stats (times summed over all threads):\n";
+    for (int kind = 0; kind < static_cast<int>(StatKind::Count); ++kind) {
+        uint64_t count = stats.count[kind];
+        if (count == 0) continue;
+        double totalMs = stats.nanoseconds[kind] / 1e6;
+        std::cout << "  " << std::left << std::setw(14) << ScanStats::name(static_cast<StatKind>(kind)) << std::right
+                  << std::setw(12) << count << std::fixed << std::setprecision(3)
+                  << std::setw(14) << totalMs << " ms" << std::setw(12) << (stats.nanoseconds[kind] / 1e3 / count)
+                  << " us avg\n" << std::defaultfloat << std::setprecision(6);
+    }
+}
+
+// Print the memory report of a scan: bytes per structure, then allocations per phase
+void printMemoryReport(const MemoryReport& memory) {
+    if (!memory.enabled) return;
+    std::cout << "Memory report (process peak RSS " << formatSize(memory.processPeakRssBytes) << "):\n";
+    for (int kind = 0; kind < static_cast<int>(MemoryKind::Count); ++kind) {
+        std::cout << "  " << std::left << std::setw(12) << MemoryReport::name(static_cast<MemoryKind>(kind)) << std::right
+                  << std::setw(12) << formatSize(memory.bytes[kind]) << " in " << std::setw(8) << memory.allocations[kind]
+                  << " allocations, peak held " << formatSize(memory.peakLiveBytes[kind]) << "\n";
+    }
+    std::cout << "Allocations by phase" << (memory.allAllocations ? "" : " (library structures only)") << ":\n";
+    for (int phase = 0; phase < static_cast<int>(ScanPhase::Count); ++phase) {
+        std::cout << "  " << std::left << std::setw(12) << MemoryReport::name(static_cast<ScanPhase>(phase)) << std::right
+                  << std::setw(12) << memory.phaseAllocations[phase] << " allocations, "
+                  << formatSize(memory.phaseBytes[phase]) << "\n";
     }
 }
 
+// Name of the limit that stopped a scan
+const char* stopReasonName(StopReason reason) {
+    switch (reason) {
+        case StopReason::Cancelled: return "cancelled";
+        case StopReason::Deadline: return "deadline";
+        case StopReason::EntryBudget: return "entry budget";
+        case StopReason::SyscallBudget: return "syscall budget";
+        default: return "none";
+    }
+}
+
+// Print the truncation note of a scan stopped by a deadline or budget
+void printTruncation(StopReason reason, uint64_t truncatedAt) {
+    if (reason == StopReason::None) return;
+    std::cout << "Truncated at " << truncatedAt << " entries (" << stopReasonName(reason) << ")\n";
+}
+
+// Parse the numeric argument of a limit option; false (with a message) if missing or invalid
+bool parseLimit(int argc, char* argv[], int& i, const std::string& option, uint64_t& value) {
+    if (i + 1 >= argc) {
+        std::cerr << "Error: " << option << " requires a number\n";
+        return false;
+    }
+    try {
+        value = std::stoull(argv[++i]);
+    } catch (const std::exception&) {
+        std::cerr << "Error: Invalid " << option << " value\n";
+        return false;
+    }
+    return true;
+}
+
 int main(int argc, char* argv[]) {
     if (argc < 2) {
         printUsage();
@@ -75,6 +250,21 @@ int main(int argc, char* argv[]) {
     bool useAllocatedSize = true;
     bool includeDirectorySize = true;
     bool rootOnly = false;
+    bool useIoUring = false;
+    size_t topK = 0;
+    bool showProgress = false;
+    uint64_t deadlineMs = 0;
+    std::string snapshotPath;
+    std::string savePath;
+    std::string loadPath;
+    std::string diffPath;
+    bool showStats = false;
+    bool memoryReport = false;
+    bool oneFileSystem = false;
+    std::string tracePath;
+    uint64_t diffLimit = 50;
+    uint64_t maxEntries = 0;
+    uint64_t maxSyscalls = 0;
     
     for (int i = 1; i < argc; ++i) {
         std::string arg = argv[i];
@@ -92,6 +282,12 @@ int main(int argc, char* argv[]) {
         else if (arg == "-r" || arg == "--root-only") {
             rootOnly = true;
         }
+        else if (arg == "-u" || arg == "--io-uring") {
+            useIoUring = true;
+        }
+        else if (arg == "-x" || arg == "--one-file-system") {
+            oneFileSystem = true;
+        }
         else if (arg == "-j" || arg == "--threads") {
             if (i + 1 < argc) {
                 try {
@@ -109,11 +305,71 @@ int main(int argc, char* argv[]) {
                 return 1;
             }
         }
+        else if (arg == "--snapshot") {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: --snapshot requires a file path\n";
+                return 1;
+            }
+            snapshotPath = argv[++i];
+        }
+        else if (arg == "--save" || arg == "--load" || arg == "--diff") {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: " << arg << " requires a file path\n";
+                return 1;
+            }
+            (arg == "--save" ? savePath : arg == "--load" ? loadPath : diffPath) = argv[++i];
+        }
+        else if (arg == "--diff-limit") {
+            if (!parseLimit(argc, argv, i, arg, diffLimit)) return 1;
+        }
+        else if (arg == "--deadline") {
+            if (!parseLimit(argc, argv, i, arg, deadlineMs)) return 1;
+        }
+        else if (arg == "--max-entries") {
+            if (!parseLimit(argc, argv, i, arg, maxEntries)) return 1;
+        }
+        else if (arg == "--max-syscalls") {
+            if (!parseLimit(argc, argv, i, arg, maxSyscalls)) return 1;
+        }
+        else if (arg == "--trace") {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: --trace requires a file path\n";
+                return 1;
+            }
+            tracePath = argv[++i];
+        }
+        else if (arg == "--stats") {
+            showStats = true;
+        }
+        else if (arg == "--mem-report") {
+            memoryReport = true;
+        }
+        else if (arg == "--progress") {
+            showProgress = true;
+        }
+        else if (arg == "--top") {
+            if (i + 1 < argc) {
+                try {
+                    int value = std::stoi(argv[++i]);
+                    if (value <= 0) {
+                        std::cerr << "Error: --top count must be positive\n";
+                        return 1;
+                    }
+                    topK = static_cast<size_t>(value);
+                } catch (const std::exception&) {
+                    std::cerr << "Error: Invalid --top count\n";
+                    return 1;
+                }
+            } else {
+                std::cerr << "Error: --top requires a number\n";
+                return 1;
+            }
+        }
         else if (arg.find("--allocated-size=") == 0) {
             useAllocatedSize = (arg.substr(17) != "0");
         }
         else if (arg.find("--include-directory-size=") == 0) {
-            includeDirectorySize = (arg.substr(26) != "0");
+            includeDirectorySize = (arg.substr(25) != "0");
         }
         else if (arg[0] == '-') {
             std::cerr << "Unknown option: " << arg << "\n";
@@ -130,24 +386,98 @@ int main(int argc, char* argv[]) {
         }
     }
     
-    if (directoryPath.empty()) {
+    if (directoryPath.empty() && loadPath.empty()) {
         std::cerr << "Error: No directory path specified\n";
         printUsage();
         return 1;
     }
     
     // Create calculator with specified settings
-    FZC calculator(useParallelProcessing, maxThreads, useAllocatedSize, includeDirectorySize);
+    FZC calculator(useParallelProcessing, maxThreads, useAllocatedSize, includeDirectorySize, useIoUring);
+    calculator.setSnapshotPath(snapshotPath);
+    calculator.setTracePath(tracePath);
+    calculator.setMemoryReport(memoryReport);
+    calculator.setOneFileSystem(oneFileSystem);
+    ScanProgress progress;
+    std::unique_ptr<ProgressPrinter> progressPrinter;
+    if (showProgress) {
+        calculator.setProgress(&progress);
+        progressPrinter = std::make_unique<ProgressPrinter>(progress);
+    }
+    
+    // Limits travel on the cancellation token; a stopped scan still reports what it walked
+    CancellationToken token;
+    if (deadlineMs > 0) token.setTimeLimit(std::chrono::milliseconds(deadlineMs));
+    token.setMaxEntries(maxEntries);
+    token.setMaxSyscalls(maxSyscalls);
+    
+    if (topK > 0) {
+        auto topResult = calculator.calculateTopK(directoryPath, topK, &token);
+        if (progressPrinter) progressPrinter->stop();
+        if (!timeOnly) {
+            std::cout << "\nResults for: " << directoryPath << "\n\n";
+            printTopK("Largest directories", topResult.largestDirectories);
+            std::cout << "\n";
+            printTopK("Largest files", topResult.largestFiles);
+            std::cout << "\nTotal size: " << topResult.totalSize << " bytes\n";
+            if (topResult.hardLinkSavings > 0) {
+                std::cout << "Hard-link savings: " << topResult.hardLinkSavings << " bytes\n";
+            }
+        }
+        printTruncation(topResult.stopReason, topResult.truncatedAt);
+        std::cout << "Time taken: " << topResult.elapsedTimeMs << " ms\n";
+        return 0;
+    }
     
-    // Calculate sizes
-    auto result = calculator.calculateFolderSizes(directoryPath, rootOnly);
+    // Calculate sizes, or map a saved result
+    auto result = loadPath.empty() ? calculator.calculateFolderSizes(directoryPath, rootOnly, &token)
+                                   : FolderSizeResult::load(loadPath);
+    if (progressPrinter) progressPrinter->stop();
     
     // Print results
+    if (!result.rootNode) {
+        if (!loadPath.empty()) {
+            std::cerr << "Error: could not load result from " << loadPath << "\n";
+            return 1;
+        }
+        if (!timeOnly) {
+            std::cerr << "Error: could not calculate size of " << directoryPath << "\n";
+            return 1;
+        }
+    }
+    if (!savePath.empty() && result.rootNode && !result.save(savePath)) {
+        std::cerr << "Error: could not save result to " << savePath << "\n";
+        return 1;
+    }
+    if (!loadPath.empty()) directoryPath = result.tree->path(result.rootIndex);
+    if (!diffPath.empty()) {
+        auto previous = FolderSizeResult::load(diffPath);
+        if (!previous.rootNode || !result.rootNode) {
+            std::cerr << "Error: could not load result from " << diffPath << "\n";
+            return 1;
+        }
+        DiffOptions options;
+        options.maxEntries = static_cast<size_t>(diffLimit);
+        printDiff(FolderSizeResult::diff(previous, result, options));
+        return 0;
+    }
     if (!timeOnly) {
         std::cout << "\nResults for: " << directoryPath << "\n\n";
-        printNode(result.rootNode, 0, timeOnly);
+        printNode(*result.tree, result.rootIndex, result.tree->path(result.rootIndex), 0, timeOnly);
         std::cout << "\nTotal size: " << result.rootNode->size << " bytes\n";
+        if (result.hardLinkSavings > 0) {
+            std::cout << "Hard-link savings: " << result.hardLinkSavings << " bytes\n";
+        }
+        if (result.sparseFiles > 0) {
+            std::cout << "Sparse or compressed files: " << result.sparseFiles << "\n";
+        }
+    }
+    printTruncation(result.stopReason, result.truncatedAt);
+    if (!snapshotPath.empty()) {
+        std::cout << "Snapshot: " << result.reusedDirectories << " directories reused\n";
     }
+    if (showStats) printStats(result.stats);
+    printMemoryReport(result.memory);
     
     std::cout << "Time taken: " << result.elapsedTimeMs << " ms\n";
     
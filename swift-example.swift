@@ -4,6 +4,9 @@ import Foundation
 public typealias FileNodePtr = UnsafeMutableRawPointer
 public typealias FolderSizeResultPtr = UnsafeMutableRawPointer
 public typealias CancellationTokenPtr = UnsafeMutableRawPointer
+public typealias ScanProgressPtr = UnsafeMutableRawPointer
+public typealias ResultDiffPtr = UnsafeMutableRawPointer
+public typealias ScanRequestPtr = UnsafeMutableRawPointer
     
 // Load the library dynamically
 private func loadLibrary(_ libraryName: String) -> UnsafeMutableRawPointer? {
@@ -36,12 +39,128 @@ private func getSymbol<T>(_ libraryHandle: UnsafeMutableRawPointer?,  _ name: St
 
 private let FZCLibraryHandle = loadLibrary("fzc")
 
+// Pass an optional string to C as a nullable C string
+private func withOptionalCString<R>(_ string: String?, _ body: (UnsafePointer<CChar>?) -> R) -> R {
+    guard let string = string else { return body(nil) }
+    return string.withCString { body($0) }
+}
+
 private class FZCLoader {
     // Renamed C function references to avoid naming conflicts
     static let c_calculateFolderSizes: (@convention(c) (UnsafePointer<CChar>, Bool, Bool, Bool, CancellationTokenPtr?) -> FolderSizeResultPtr?)? = {
         getSymbol(FZCLibraryHandle, "calculateFolderSizes")
     }()
     
+    // Scan requests: one handle carries every optional setting of a scan
+    static let c_createScanRequest: (@convention(c) (UnsafePointer<CChar>) -> ScanRequestPtr?)? = {
+        getSymbol(FZCLibraryHandle, "createScanRequest")
+    }()
+    static let c_setScanRootOnly: (@convention(c) (ScanRequestPtr?, Bool) -> Void)? = {
+        getSymbol(FZCLibraryHandle, "setScanRootOnly")
+    }()
+    static let c_setScanAllocatedSize: (@convention(c) (ScanRequestPtr?, Bool) -> Void)? = {
+        getSymbol(FZCLibraryHandle, "setScanAllocatedSize")
+    }()
+    static let c_setScanDirectorySize: (@convention(c) (ScanRequestPtr?, Bool) -> Void)? = {
+        getSymbol(FZCLibraryHandle, "setScanDirectorySize")
+    }()
+    static let c_setScanMaxThreads: (@convention(c) (ScanRequestPtr?, Int32) -> Void)? = {
+        getSymbol(FZCLibraryHandle, "setScanMaxThreads")
+    }()
+    static let c_setScanCancellationToken: (@convention(c) (ScanRequestPtr?, CancellationTokenPtr?) -> Void)? = {
+        getSymbol(FZCLibraryHandle, "setScanCancellationToken")
+    }()
+    static let c_setScanProgress: (@convention(c) (ScanRequestPtr?, ScanProgressPtr?) -> Void)? = {
+        getSymbol(FZCLibraryHandle, "setScanProgress")
+    }()
+    static let c_setScanSnapshotPath: (@convention(c) (ScanRequestPtr?, UnsafePointer<CChar>?) -> Void)? = {
+        getSymbol(FZCLibraryHandle, "setScanSnapshotPath")
+    }()
+    static let c_setScanTracePath: (@convention(c) (ScanRequestPtr?, UnsafePointer<CChar>?) -> Void)? = {
+        getSymbol(FZCLibraryHandle, "setScanTracePath")
+    }()
+    static let c_setScanMemoryReport: (@convention(c) (ScanRequestPtr?, Bool) -> Void)? = {
+        getSymbol(FZCLibraryHandle, "setScanMemoryReport")
+    }()
+    static let c_runScanRequest: (@convention(c) (ScanRequestPtr?) -> FolderSizeResultPtr?)? = {
+        getSymbol(FZCLibraryHandle, "runScanRequest")
+    }()
+    static let c_releaseScanRequest: (@convention(c) (ScanRequestPtr?) -> Void)? = {
+        getSymbol(FZCLibraryHandle, "releaseScanRequest")
+    }()
+    static let c_getResultReusedDirectories: (@convention(c) (FolderSizeResultPtr?) -> UInt64)? = {
+        getSymbol(FZCLibraryHandle, "getResultReusedDirectories")
+    }()
+    
+    // Binary result files
+    static let c_saveResult: (@convention(c) (FolderSizeResultPtr?, UnsafePointer<CChar>) -> Bool)? = {
+        getSymbol(FZCLibraryHandle, "saveResult")
+    }()
+    static let c_loadResult: (@convention(c) (UnsafePointer<CChar>) -> FolderSizeResultPtr?)? = {
+        getSymbol(FZCLibraryHandle, "loadResult")
+    }()
+    
+    // Result comparison
+    static let c_diffResults: (@convention(c) (FolderSizeResultPtr?, FolderSizeResultPtr?, UInt64, Int32) -> ResultDiffPtr?)? = {
+        getSymbol(FZCLibraryHandle, "diffResults")
+    }()
+    static let c_getDiffCount: (@convention(c) (ResultDiffPtr?) -> Int32)? = {
+        getSymbol(FZCLibraryHandle, "getDiffCount")
+    }()
+    static let c_getDiffPath: (@convention(c) (ResultDiffPtr?, Int32) -> UnsafePointer<CChar>?)? = {
+        getSymbol(FZCLibraryHandle, "getDiffPath")
+    }()
+    static let c_getDiffKind: (@convention(c) (ResultDiffPtr?, Int32) -> Int32)? = {
+        getSymbol(FZCLibraryHandle, "getDiffKind")
+    }()
+    static let c_isDiffDirectory: (@convention(c) (ResultDiffPtr?, Int32) -> Bool)? = {
+        getSymbol(FZCLibraryHandle, "isDiffDirectory")
+    }()
+    static let c_getDiffOldSize: (@convention(c) (ResultDiffPtr?, Int32) -> UInt64)? = {
+        getSymbol(FZCLibraryHandle, "getDiffOldSize")
+    }()
+    static let c_getDiffNewSize: (@convention(c) (ResultDiffPtr?, Int32) -> UInt64)? = {
+        getSymbol(FZCLibraryHandle, "getDiffNewSize")
+    }()
+    static let c_releaseDiff: (@convention(c) (ResultDiffPtr?) -> Void)? = {
+        getSymbol(FZCLibraryHandle, "releaseDiff")
+    }()
+    
+    // Progress functions
+    static let c_createScanProgress: (@convention(c) () -> ScanProgressPtr?)? = {
+        getSymbol(FZCLibraryHandle, "createScanProgress")
+    }()
+    static let c_releaseScanProgress: (@convention(c) (ScanProgressPtr?) -> Void)? = {
+        getSymbol(FZCLibraryHandle, "releaseScanProgress")
+    }()
+    static let c_getProgressEntries: (@convention(c) (ScanProgressPtr?) -> UInt64)? = {
+        getSymbol(FZCLibraryHandle, "getProgressEntries")
+    }()
+    static let c_getProgressBytes: (@convention(c) (ScanProgressPtr?) -> UInt64)? = {
+        getSymbol(FZCLibraryHandle, "getProgressBytes")
+    }()
+    static let c_getProgressDirectoriesPending: (@convention(c) (ScanProgressPtr?) -> UInt64)? = {
+        getSymbol(FZCLibraryHandle, "getProgressDirectoriesPending")
+    }()
+    static let c_getProgressDirectoriesCompleted: (@convention(c) (ScanProgressPtr?) -> UInt64)? = {
+        getSymbol(FZCLibraryHandle, "getProgressDirectoriesCompleted")
+    }()
+    static let c_getProgressErrors: (@convention(c) (ScanProgressPtr?) -> UInt64)? = {
+        getSymbol(FZCLibraryHandle, "getProgressErrors")
+    }()
+    static let c_getProgressEntriesPerSecond: (@convention(c) (ScanProgressPtr?) -> Double)? = {
+        getSymbol(FZCLibraryHandle, "getProgressEntriesPerSecond")
+    }()
+    static let c_getProgressBytesPerSecond: (@convention(c) (ScanProgressPtr?) -> Double)? = {
+        getSymbol(FZCLibraryHandle, "getProgressBytesPerSecond")
+    }()
+    static let c_getProgressIdleMs: (@convention(c) (ScanProgressPtr?) -> Double)? = {
+        getSymbol(FZCLibraryHandle, "getProgressIdleMs")
+    }()
+    static let c_isProgressRunning: (@convention(c) (ScanProgressPtr?) -> Bool)? = {
+        getSymbol(FZCLibraryHandle, "isProgressRunning")
+    }()
+    
     // Cancellation token functions
     static let c_createCancellationToken: (@convention(c) () -> CancellationTokenPtr?)? = {
         getSymbol(FZCLibraryHandle, "createCancellationToken")
@@ -52,6 +171,18 @@ private class FZCLoader {
     static let c_isTokenCancelled: (@convention(c) (CancellationTokenPtr?) -> Bool)? = {
         getSymbol(FZCLibraryHandle, "isTokenCancelled")
     }()
+    static let c_setTokenKeepPartialResults: (@convention(c) (CancellationTokenPtr?, Bool) -> Void)? = {
+        getSymbol(FZCLibraryHandle, "setTokenKeepPartialResults")
+    }()
+    static let c_setTokenTimeLimitMs: (@convention(c) (CancellationTokenPtr?, UInt64) -> Void)? = {
+        getSymbol(FZCLibraryHandle, "setTokenTimeLimitMs")
+    }()
+    static let c_setTokenMaxEntries: (@convention(c) (CancellationTokenPtr?, UInt64) -> Void)? = {
+        getSymbol(FZCLibraryHandle, "setTokenMaxEntries")
+    }()
+    static let c_setTokenMaxSyscalls: (@convention(c) (CancellationTokenPtr?, UInt64) -> Void)? = {
+        getSymbol(FZCLibraryHandle, "setTokenMaxSyscalls")
+    }()
     static let c_releaseCancellationToken: (@convention(c) (CancellationTokenPtr?) -> Void)? = {
         getSymbol(FZCLibraryHandle, "releaseCancellationToken")
     }()
@@ -62,6 +193,63 @@ private class FZCLoader {
     static let c_getResultElapsedTimeMs: (@convention(c) (FolderSizeResultPtr?) -> Double)? = {
         getSymbol(FZCLibraryHandle, "getResultElapsedTimeMs")
     }()
+    static let c_getResultHardLinkSavings: (@convention(c) (FolderSizeResultPtr?) -> UInt64)? = {
+        getSymbol(FZCLibraryHandle, "getResultHardLinkSavings")
+    }()
+    static let c_getResultSparseFiles: (@convention(c) (FolderSizeResultPtr?) -> UInt64)? = {
+        getSymbol(FZCLibraryHandle, "getResultSparseFiles")
+    }()
+    static let c_isResultComplete: (@convention(c) (FolderSizeResultPtr?) -> Bool)? = {
+        getSymbol(FZCLibraryHandle, "isResultComplete")
+    }()
+    static let c_getResultStopReason: (@convention(c) (FolderSizeResultPtr?) -> Int32)? = {
+        getSymbol(FZCLibraryHandle, "getResultStopReason")
+    }()
+    static let c_getResultTruncatedAt: (@convention(c) (FolderSizeResultPtr?) -> UInt64)? = {
+        getSymbol(FZCLibraryHandle, "getResultTruncatedAt")
+    }()
+    static let c_areResultStatsEnabled: (@convention(c) (FolderSizeResultPtr?) -> Bool)? = {
+        getSymbol(FZCLibraryHandle, "areResultStatsEnabled")
+    }()
+    static let c_getResultStatCount: (@convention(c) (FolderSizeResultPtr?, Int32) -> UInt64)? = {
+        getSymbol(FZCLibraryHandle, "getResultStatCount")
+    }()
+    static let c_getResultStatNanoseconds: (@convention(c) (FolderSizeResultPtr?, Int32) -> UInt64)? = {
+        getSymbol(FZCLibraryHandle, "getResultStatNanoseconds")
+    }()
+    static let c_getStatKindName: (@convention(c) (Int32) -> UnsafePointer<CChar>?)? = {
+        getSymbol(FZCLibraryHandle, "getStatKindName")
+    }()
+    static let c_isResultMemoryReported: (@convention(c) (FolderSizeResultPtr?) -> Bool)? = {
+        getSymbol(FZCLibraryHandle, "isResultMemoryReported")
+    }()
+    static let c_areAllAllocationsCounted: (@convention(c) (FolderSizeResultPtr?) -> Bool)? = {
+        getSymbol(FZCLibraryHandle, "areAllAllocationsCounted")
+    }()
+    static let c_getResultProcessPeakRss: (@convention(c) (FolderSizeResultPtr?) -> UInt64)? = {
+        getSymbol(FZCLibraryHandle, "getResultProcessPeakRss")
+    }()
+    static let c_getResultMemoryBytes: (@convention(c) (FolderSizeResultPtr?, Int32) -> UInt64)? = {
+        getSymbol(FZCLibraryHandle, "getResultMemoryBytes")
+    }()
+    static let c_getResultMemoryAllocations: (@convention(c) (FolderSizeResultPtr?, Int32) -> UInt64)? = {
+        getSymbol(FZCLibraryHandle, "getResultMemoryAllocations")
+    }()
+    static let c_getResultMemoryPeakLive: (@convention(c) (FolderSizeResultPtr?, Int32) -> UInt64)? = {
+        getSymbol(FZCLibraryHandle, "getResultMemoryPeakLive")
+    }()
+    static let c_getResultPhaseBytes: (@convention(c) (FolderSizeResultPtr?, Int32) -> UInt64)? = {
+        getSymbol(FZCLibraryHandle, "getResultPhaseBytes")
+    }()
+    static let c_getResultPhaseAllocations: (@convention(c) (FolderSizeResultPtr?, Int32) -> UInt64)? = {
+        getSymbol(FZCLibraryHandle, "getResultPhaseAllocations")
+    }()
+    static let c_getMemoryKindName: (@convention(c) (Int32) -> UnsafePointer<CChar>?)? = {
+        getSymbol(FZCLibraryHandle, "getMemoryKindName")
+    }()
+    static let c_getScanPhaseName: (@convention(c) (Int32) -> UnsafePointer<CChar>?)? = {
+        getSymbol(FZCLibraryHandle, "getScanPhaseName")
+    }()
     static let c_getNodePath: (@convention(c) (FileNodePtr?) -> UnsafePointer<CChar>?)? = {
         getSymbol(FZCLibraryHandle, "getNodePath")
     }()
@@ -71,6 +259,12 @@ private class FZCLoader {
     static let c_isNodeDirectory: (@convention(c) (FileNodePtr?) -> Bool)? = {
         getSymbol(FZCLibraryHandle, "isNodeDirectory")
     }()
+    static let c_isNodeComplete: (@convention(c) (FileNodePtr?) -> Bool)? = {
+        getSymbol(FZCLibraryHandle, "isNodeComplete")
+    }()
+    static let c_isNodeSparse: (@convention(c) (FileNodePtr?) -> Bool)? = {
+        getSymbol(FZCLibraryHandle, "isNodeSparse")
+    }()
     static let c_getChildrenCount: (@convention(c) (FileNodePtr?) -> Int32)? = {
         getSymbol(FZCLibraryHandle, "getChildrenCount")
     }()
@@ -92,6 +286,9 @@ class FileNode: Hashable, Identifiable {
     let path: String
     let size: UInt64
     let isDirectory: Bool
+    let isComplete: Bool
+    // Allocated size differs from apparent size (sparse or compressed file)
+    let isSparse: Bool
     let depth: Int
     public private(set) lazy var children: [FileNode] = { self.getChildNodes() }()
     
@@ -123,6 +320,8 @@ class FileNode: Hashable, Identifiable {
         
         self.size = FZCLoader.c_getNodeSize?(nodePtr) ?? 0
         self.isDirectory = FZCLoader.c_isNodeDirectory?(nodePtr) ?? false
+        self.isComplete = FZCLoader.c_isNodeComplete?(nodePtr) ?? true
+        self.isSparse = FZCLoader.c_isNodeSparse?(nodePtr) ?? false
     }
     
     deinit {
@@ -151,11 +350,110 @@ class FileSizeCalculator {
     struct Result {
         let rootNode: FileNode
         let elapsedTimeMs: Double
+        let hardLinkSavings: UInt64
+        // Files whose allocated size differs from their apparent size
+        let sparseFiles: UInt64
+        let isComplete: Bool
+        // Entries scanned when a deadline or budget stopped the scan (0 if it ran to the end)
+        let truncatedAt: UInt64
+        // StopReason value: 0 none, 1 cancelled, 2 deadline, 3 entry budget, 4 syscall budget
+        let stopReason: Int32
+        // Per-operation counts and times; empty unless the library was built with FZC_ENABLE_STATS
+        let stats: [OperationStat]
+        // Peak RSS and allocations by structure and phase; nil unless requested with memoryReport:
+        let memory: MemoryReport?
         
-        init(rootNode: FileNode, elapsedTimeMs: Double) {
+        init(rootNode: FileNode, elapsedTimeMs: Double, hardLinkSavings: UInt64 = 0, sparseFiles: UInt64 = 0, isComplete: Bool = true,
+             truncatedAt: UInt64 = 0, stopReason: Int32 = 0, stats: [OperationStat] = [], memory: MemoryReport? = nil) {
             self.rootNode = rootNode
             self.elapsedTimeMs = elapsedTimeMs
+            self.hardLinkSavings = hardLinkSavings
+            self.sparseFiles = sparseFiles
+            self.isComplete = isComplete
+            self.truncatedAt = truncatedAt
+            self.stopReason = stopReason
+            self.stats = stats
+            self.memory = memory
+        }
+    }
+    
+    struct OperationStat {
+        let name: String
+        let count: UInt64
+        let nanoseconds: UInt64
+    }
+    
+    // Number of StatKind values in the C++ library
+    private static let statKindCount: Int32 = 12
+    
+    private static func readStats(_ resultPtr: FolderSizeResultPtr) -> [OperationStat] {
+        guard FZCLoader.c_areResultStatsEnabled?(resultPtr) == true else { return [] }
+        var stats = [OperationStat]()
+        for kind in 0..<statKindCount {
+            let count = FZCLoader.c_getResultStatCount?(resultPtr, kind) ?? 0
+            guard count > 0, let namePtr = FZCLoader.c_getStatKindName?(kind) else { continue }
+            stats.append(OperationStat(name: String(cString: namePtr), count: count,
+                                       nanoseconds: FZCLoader.c_getResultStatNanoseconds?(resultPtr, kind) ?? 0))
+        }
+        return stats
+    }
+
+    struct MemoryReport {
+        struct Structure {
+            let name: String
+            let bytes: UInt64
+            let allocations: UInt64
+            let peakLiveBytes: UInt64
+        }
+        struct Phase {
+            let name: String
+            let allocations: UInt64
+            let bytes: UInt64
+        }
+        // Lifetime peak of the whole process when the scan ended, not of this scan alone
+        let processPeakRssBytes: UInt64
+        // false when phase counts only cover the library's own structures
+        let allAllocations: Bool
+        let structures: [Structure]
+        let phases: [Phase]
+    }
+    
+    // Number of MemoryKind and ScanPhase values in the C++ library
+    private static let memoryKindCount: Int32 = 4
+    private static let scanPhaseCount: Int32 = 5
+    
+    private static func readMemoryReport(_ resultPtr: FolderSizeResultPtr) -> MemoryReport? {
+        guard FZCLoader.c_isResultMemoryReported?(resultPtr) == true else { return nil }
+        var structures = [MemoryReport.Structure]()
+        for kind in 0..<memoryKindCount {
+            guard let namePtr = FZCLoader.c_getMemoryKindName?(kind) else { continue }
+            structures.append(MemoryReport.Structure(name: String(cString: namePtr),
+                                                     bytes: FZCLoader.c_getResultMemoryBytes?(resultPtr, kind) ?? 0,
+                                                     allocations: FZCLoader.c_getResultMemoryAllocations?(resultPtr, kind) ?? 0,
+                                                     peakLiveBytes: FZCLoader.c_getResultMemoryPeakLive?(resultPtr, kind) ?? 0))
         }
+        var phases = [MemoryReport.Phase]()
+        for phase in 0..<scanPhaseCount {
+            guard let namePtr = FZCLoader.c_getScanPhaseName?(phase) else { continue }
+            phases.append(MemoryReport.Phase(name: String(cString: namePtr),
+                                             allocations: FZCLoader.c_getResultPhaseAllocations?(resultPtr, phase) ?? 0,
+                                             bytes: FZCLoader.c_getResultPhaseBytes?(resultPtr, phase) ?? 0))
+        }
+        return MemoryReport(processPeakRssBytes: FZCLoader.c_getResultProcessPeakRss?(resultPtr) ?? 0,
+                            allAllocations: FZCLoader.c_areAllAllocationsCounted?(resultPtr) ?? false,
+                            structures: structures, phases: phases)
+    }
+
+    // One difference between two saved results
+    struct Change {
+        enum Kind: Int32 {
+            case added = 0, removed, grown, shrunk
+        }
+        let path: String
+        let kind: Kind
+        let isDirectory: Bool
+        let oldSize: UInt64
+        let newSize: UInt64
     }
 
     public class CancellationToken {
@@ -163,8 +461,12 @@ class FileSizeCalculator {
         private let lock = NSLock()
         private var isReleased = false
         
-        public init() {
+        // keepPartialResults: a cancelled calculation returns the partial tree instead of nil
+        public init(keepPartialResults: Bool = false) {
             self.tokenPtr = FZCLoader.c_createCancellationToken?()
+            if keepPartialResults {
+                FZCLoader.c_setTokenKeepPartialResults?(tokenPtr, true)
+            }
         }
         
         deinit {
@@ -177,6 +479,17 @@ class FileSizeCalculator {
             }
         }
         
+        // Limits are checked cooperatively while scanning; a scan stopped by one keeps its partial result
+        public func setLimits(timeLimitMs: UInt64 = 0, maxEntries: UInt64 = 0, maxSyscalls: UInt64 = 0) {
+            lock.lock()
+            defer { lock.unlock() }
+            
+            guard !isReleased else { return }
+            FZCLoader.c_setTokenTimeLimitMs?(tokenPtr, timeLimitMs)
+            FZCLoader.c_setTokenMaxEntries?(tokenPtr, maxEntries)
+            FZCLoader.c_setTokenMaxSyscalls?(tokenPtr, maxSyscalls)
+        }
+        
         public func cancel() {
             lock.lock()
             defer { lock.unlock() }
@@ -201,6 +514,32 @@ class FileSizeCalculator {
         }
     }
     
+    // Live counters of a running scan; poll the properties from any thread
+    public class ScanProgress {
+        private let progressPtr: ScanProgressPtr?
+        
+        public init() {
+            self.progressPtr = FZCLoader.c_createScanProgress?()
+        }
+        
+        deinit {
+            FZCLoader.c_releaseScanProgress?(progressPtr)
+        }
+        
+        public var entries: UInt64 { FZCLoader.c_getProgressEntries?(progressPtr) ?? 0 }
+        public var bytes: UInt64 { FZCLoader.c_getProgressBytes?(progressPtr) ?? 0 }
+        public var directoriesPending: UInt64 { FZCLoader.c_getProgressDirectoriesPending?(progressPtr) ?? 0 }
+        public var directoriesCompleted: UInt64 { FZCLoader.c_getProgressDirectoriesCompleted?(progressPtr) ?? 0 }
+        public var errors: UInt64 { FZCLoader.c_getProgressErrors?(progressPtr) ?? 0 }
+        public var entriesPerSecond: Double { FZCLoader.c_getProgressEntriesPerSecond?(progressPtr) ?? 0 }
+        public var bytesPerSecond: Double { FZCLoader.c_getProgressBytesPerSecond?(progressPtr) ?? 0 }
+        // Milliseconds since the scan last made progress, for stall detection
+        public var idleMs: Double { FZCLoader.c_getProgressIdleMs?(progressPtr) ?? 0 }
+        public var isRunning: Bool { FZCLoader.c_isProgressRunning?(progressPtr) ?? false }
+        
+        internal var rawPointer: ScanProgressPtr? { progressPtr }
+    }
+    
     private let useParallelProcessing: Bool
     private let maxThreads: Int
     
@@ -216,7 +555,12 @@ class FileSizeCalculator {
         rootOnly: Bool = false,
         useAllocatedSize: Bool = true,
         includeDirectorySize: Bool = true,
-        cancellationToken: CancellationToken? = nil
+        cancellationToken: CancellationToken? = nil,
+        progress: ScanProgress? = nil,
+        snapshotPath: String? = nil,
+        tracePath: String? = nil,
+        memoryReport: Bool = false,
+        saveTo resultFile: String? = nil
     ) -> Result? {
         guard FileManager.default.fileExists(atPath: path) else {
             logger.log("File does not exist at \(path)")
@@ -237,8 +581,28 @@ class FileSizeCalculator {
             return nil
         }
         
-        // Pass the cancellation token to the C function
-        let resultPtr = standardFunc(cPath, rootOnly, useAllocatedSize, includeDirectorySize, cancellationToken?.rawPointer)
+        // Every optional setting goes on a scan request; without one, only the plain entry point is used
+        let resultPtr: FolderSizeResultPtr?
+        if let createFunc = FZCLoader.c_createScanRequest,
+           let runFunc = FZCLoader.c_runScanRequest,
+           let request = createFunc(cPath) {
+            defer { FZCLoader.c_releaseScanRequest?(request) }
+            FZCLoader.c_setScanRootOnly?(request, rootOnly)
+            FZCLoader.c_setScanAllocatedSize?(request, useAllocatedSize)
+            FZCLoader.c_setScanDirectorySize?(request, includeDirectorySize)
+            FZCLoader.c_setScanMaxThreads?(request, Int32(useParallelProcessing ? maxThreads : 1))
+            FZCLoader.c_setScanCancellationToken?(request, cancellationToken?.rawPointer)
+            FZCLoader.c_setScanProgress?(request, progress?.rawPointer)
+            // Unchanged directories are reused from the snapshot file, which is refreshed afterwards
+            withOptionalCString(snapshotPath) { FZCLoader.c_setScanSnapshotPath?(request, $0) }
+            // A Chrome trace of worker activity is written to tracePath when the scan ends
+            withOptionalCString(tracePath) { FZCLoader.c_setScanTracePath?(request, $0) }
+            // Allocations are counted by structure and scan phase into Result.memory
+            FZCLoader.c_setScanMemoryReport?(request, memoryReport)
+            resultPtr = runFunc(request)
+        } else {
+            resultPtr = standardFunc(cPath, rootOnly, useAllocatedSize, includeDirectorySize, cancellationToken?.rawPointer)
+        }
 
         // Process the result pointer
         guard let ptr = resultPtr else {
@@ -251,13 +615,80 @@ class FileSizeCalculator {
             FZCLoader.c_releaseResult?(ptr)
         }
         
+        if let resultFile = resultFile, FZCLoader.c_saveResult?(ptr, resultFile) != true {
+            logger.log("Failed to save result to \(resultFile)")
+        }
+        
         let elapsedTimeMs = getResultElapsedTimeMsFunc(ptr)
+        let hardLinkSavings = FZCLoader.c_getResultHardLinkSavings?(ptr) ?? 0
+        let sparseFiles = FZCLoader.c_getResultSparseFiles?(ptr) ?? 0
+        let isComplete = FZCLoader.c_isResultComplete?(ptr) ?? true
+        let truncatedAt = FZCLoader.c_getResultTruncatedAt?(ptr) ?? 0
+        let stopReason = FZCLoader.c_getResultStopReason?(ptr) ?? 0
         if let nodePtr = getResultRootNodeFunc(ptr), FileManager.default.fileExists(atPath: path) {
             let rootNode = FileNode(nodePtr: nodePtr, parentNode: nil)
-            return Result(rootNode: rootNode, elapsedTimeMs: elapsedTimeMs)
+            return Result(rootNode: rootNode, elapsedTimeMs: elapsedTimeMs, hardLinkSavings: hardLinkSavings, sparseFiles: sparseFiles, isComplete: isComplete,
+                          truncatedAt: truncatedAt, stopReason: stopReason, stats: FileSizeCalculator.readStats(ptr),
+                          memory: FileSizeCalculator.readMemoryReport(ptr))
         }
         
         logger.log("Failed to obtain result node")
         return nil
     }
+    
+    // What changed between two results written with saveTo:, largest change first
+    func diff(from oldFile: String, to newFile: String, minDelta: UInt64 = 0, maxEntries: Int = 0) -> [Change]? {
+        guard
+            let loadFunc = FZCLoader.c_loadResult,
+            let diffFunc = FZCLoader.c_diffResults,
+            let oldPtr = loadFunc(oldFile)
+        else {
+            logger.log("Failed to load result from \(oldFile)")
+            return nil
+        }
+        defer { FZCLoader.c_releaseResult?(oldPtr) }
+        guard let newPtr = loadFunc(newFile) else {
+            logger.log("Failed to load result from \(newFile)")
+            return nil
+        }
+        defer { FZCLoader.c_releaseResult?(newPtr) }
+        guard let diffPtr = diffFunc(oldPtr, newPtr, minDelta, Int32(maxEntries)) else { return nil }
+        defer { FZCLoader.c_releaseDiff?(diffPtr) }
+        
+        var changes = [Change]()
+        let count = FZCLoader.c_getDiffCount?(diffPtr) ?? 0
+        for i in 0..<count {
+            guard let pathPtr = FZCLoader.c_getDiffPath?(diffPtr, i),
+                  let kind = Change.Kind(rawValue: FZCLoader.c_getDiffKind?(diffPtr, i) ?? -1) else { continue }
+            changes.append(Change(path: String(cString: pathPtr),
+                                  kind: kind,
+                                  isDirectory: FZCLoader.c_isDiffDirectory?(diffPtr, i) ?? false,
+                                  oldSize: FZCLoader.c_getDiffOldSize?(diffPtr, i) ?? 0,
+                                  newSize: FZCLoader.c_getDiffNewSize?(diffPtr, i) ?? 0))
+        }
+        return changes
+    }
+    
+    // Open a result written with saveTo:; the file is mapped, not parsed, so this is instant
+    func load(from resultFile: String) -> Result? {
+        guard
+            let loadFunc = FZCLoader.c_loadResult,
+            let getResultRootNodeFunc = FZCLoader.c_getResultRootNode,
+            let ptr = loadFunc(resultFile)
+        else {
+            logger.log("Failed to load result from \(resultFile)")
+            return nil
+        }
+        defer {
+            FZCLoader.c_releaseResult?(ptr)
+        }
+        guard let nodePtr = getResultRootNodeFunc(ptr) else { return nil }
+        return Result(rootNode: FileNode(nodePtr: nodePtr, parentNode: nil),
+                      elapsedTimeMs: FZCLoader.c_getResultElapsedTimeMs?(ptr) ?? 0,
+                      hardLinkSavings: FZCLoader.c_getResultHardLinkSavings?(ptr) ?? 0,
+                      sparseFiles: FZCLoader.c_getResultSparseFiles?(ptr) ?? 0,
+                      isComplete: FZCLoader.c_isResultComplete?(ptr) ?? true,
+                      truncatedAt: FZCLoader.c_getResultTruncatedAt?(ptr) ?? 0,
+                      stopReason: FZCLoader.c_getResultStopReason?(ptr) ?? 0)
+    }
 }
@@ -0,0 +1,41 @@
+#ifndef FZC_TEST_CHECK_HPP
+#define FZC_TEST_CHECK_HPP
+
+// Minimal assertion helpers for the unit tests: a failed CHECK prints the
+// expression and location and marks the test failed, but the test keeps going
+// so one run reports every failure. Each test's main returns testResult().
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+inline int& testFailures() {
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(condition)                                                                \
+    do {                                                                                \
+        if (!(condition)) {                                                             \
+            std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition); \
+            ++testFailures();                                                           \
+        }                                                                               \
+    } while (0)
+
+inline int testResult() {
+    if (testFailures() > 0) std::fprintf(stderr, "%d check(s) failed\n", testFailures());
+    return testFailures() == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Fresh directory under TMPDIR (or /tmp), removed by the caller
+inline std::string makeTempDir() {
+    const char* base = std::getenv("TMPDIR");
+    std::string pattern = std::string(base && *base ? base : "/tmp") + "/fzc_test_XXXXXX";
+    if (!mkdtemp(&pattern[0])) {
+        std::perror("mkdtemp");
+        std::exit(EXIT_FAILURE);
+    }
+    return pattern;
+}
+
+#endif // FZC_TEST_CHECK_HPP
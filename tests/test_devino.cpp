@@ -0,0 +1,53 @@
+/*
+ * test_devino.cpp
+ *
+ * DevInoSet: identity semantics and concurrent inserts.
+ */
+
+#include "fzc_devino.hpp"
+#include "test_check.hpp"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace {
+
+void testInsertOnce() {
+    DevInoSet set;
+    CHECK(set.insert(1, 100));
+    CHECK(!set.insert(1, 100));
+    // Same inode number on another device is another file
+    CHECK(set.insert(2, 100));
+    CHECK(set.insert(1, 101));
+    set.clear();
+    CHECK(set.insert(1, 100));
+}
+
+void testConcurrentInsertsWinOnce() {
+    // Every thread inserts the same identities; each must be won by exactly one thread
+    DevInoSet set;
+    const int threadCount = 4;
+    const uint64_t keyCount = 20000;
+    std::atomic<uint64_t> won{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; ++t) {
+        threads.emplace_back([&set, &won, keyCount, t] {
+            uint64_t mine = 0;
+            for (uint64_t i = 0; i < keyCount; ++i) {
+                uint64_t key = (i + static_cast<uint64_t>(t) * 7919) % keyCount;
+                if (set.insert(static_cast<dev_t>(key % 3), static_cast<ino_t>(key))) ++mine;
+            }
+            won += mine;
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    CHECK(won.load() == keyCount);
+}
+
+} // namespace
+
+int main() {
+    testInsertOnce();
+    testConcurrentInsertsWinOnce();
+    return testResult();
+}
@@ -0,0 +1,140 @@
+/*
+ * test_diff.cpp
+ *
+ * FolderSizeResult::diff on small synthetic trees.
+ */
+
+#include "fzc.hpp"
+#include "test_check.hpp"
+#include <initializer_list>
+
+namespace {
+
+// Tree built from nested specs; directory sizes are the sum of their children
+struct Spec {
+    std::string name;
+    uint64_t size;
+    bool isDirectory;
+    std::vector<Spec> children;
+};
+
+Spec file(std::string name, uint64_t size) { return {std::move(name), size, false, {}}; }
+Spec dir(std::string name, std::initializer_list<Spec> children) { return {std::move(name), 0, true, children}; }
+
+NodeIndex build(FileTree& tree, const Spec& spec) {
+    NodeIndex index = tree.addNode(spec.name, spec.size, spec.isDirectory);
+    std::vector<NodeIndex> children;
+    uint64_t total = spec.size;
+    for (const Spec& child : spec.children) {
+        NodeIndex childIndex = build(tree, child);
+        total += tree.node(childIndex).size;
+        children.push_back(childIndex);
+    }
+    tree.setChildren(index, children);
+    tree.node(index).size = total;
+    return index;
+}
+
+FolderSizeResult makeResult(const Spec& root) {
+    auto tree = std::make_shared<FileTree>();
+    NodeIndex index = build(*tree, root);
+    return FolderSizeResult(tree, index, 0.0);
+}
+
+bool isEntry(const DiffEntry& entry, const char* path, DiffKind kind, uint64_t oldSize, uint64_t newSize) {
+    return entry.path == path && entry.kind == kind && entry.oldSize == oldSize && entry.newSize == newSize;
+}
+
+FolderSizeResult before() {
+    return makeResult(dir("/data", {
+        dir("keep", {file("k1", 100)}),
+        dir("grow", {file("g1", 50)}),
+        dir("gone", {file("x", 40)}),
+        file("f.txt", 10),
+        file("swap", 5),
+    }));
+}
+
+FolderSizeResult after() {
+    return makeResult(dir("/data", {
+        file("f.txt", 4),
+        dir("new", {file("y", 20)}),
+        dir("grow", {file("g2", 30), file("g1", 50)}),
+        dir("swap", {file("z", 7)}),
+        dir("keep", {file("k1", 100)}),
+    }));
+}
+
+void testChanges() {
+    ResultDiff diff = FolderSizeResult::diff(before(), after());
+    CHECK(diff.totalDelta == 6);
+    CHECK(diff.prunedDirectories == 1);     // keep
+    CHECK(diff.comparedDirectories == 2);   // the root and grow
+    CHECK(diff.entries.size() == 8);
+    if (diff.entries.size() != 8) return;
+    // Largest change first, ties by path; added and removed subtrees reported once
+    CHECK(isEntry(diff.entries[0], "/data/gone", DiffKind::Removed, 40, 0));
+    CHECK(diff.entries[0].isDirectory);
+    CHECK(isEntry(diff.entries[1], "/data/grow", DiffKind::Grown, 50, 80));
+    CHECK(isEntry(diff.entries[2], "/data/grow/g2", DiffKind::Added, 0, 30));
+    CHECK(isEntry(diff.entries[3], "/data/new", DiffKind::Added, 0, 20));
+    // A file replaced by a directory is a removal plus an addition
+    CHECK(isEntry(diff.entries[4], "/data/swap", DiffKind::Added, 0, 7));
+    CHECK(diff.entries[4].isDirectory);
+    CHECK(isEntry(diff.entries[5], "/data", DiffKind::Grown, 205, 211));
+    CHECK(isEntry(diff.entries[6], "/data/f.txt", DiffKind::Shrunk, 10, 4));
+    CHECK(diff.entries[6].delta() == -6);
+    CHECK(isEntry(diff.entries[7], "/data/swap", DiffKind::Removed, 5, 0));
+    CHECK(!diff.entries[7].isDirectory);
+}
+
+void testOptions() {
+    DiffOptions options;
+    options.minDelta = 20;
+    ResultDiff diff = FolderSizeResult::diff(before(), after(), options);
+    CHECK(diff.entries.size() == 4);
+
+    options.maxEntries = 2;
+    diff = FolderSizeResult::diff(before(), after(), options);
+    CHECK(diff.entries.size() == 2);
+    if (diff.entries.size() == 2) {
+        CHECK(diff.entries[0].path == "/data/gone");
+        CHECK(diff.entries[1].path == "/data/grow");
+    }
+}
+
+void testEqualTotalsAreStillWalked() {
+    // Same directory total, but two files traded sizes
+    FolderSizeResult oldResult = makeResult(dir("/r", {dir("d", {file("a", 10), file("b", 20)})}));
+    FolderSizeResult newResult = makeResult(dir("/other/r", {dir("d", {file("a", 20), file("b", 10)})}));
+    ResultDiff diff = FolderSizeResult::diff(oldResult, newResult);
+    CHECK(diff.totalDelta == 0);
+    CHECK(diff.prunedDirectories == 0);
+    CHECK(diff.entries.size() == 2);
+    if (diff.entries.size() == 2) {
+        // Paths are under the newer root, whatever the old root was called
+        CHECK(isEntry(diff.entries[0], "/other/r/d/a", DiffKind::Grown, 10, 20));
+        CHECK(isEntry(diff.entries[1], "/other/r/d/b", DiffKind::Shrunk, 20, 10));
+    }
+}
+
+void testIdenticalTrees() {
+    ResultDiff diff = FolderSizeResult::diff(after(), after());
+    CHECK(diff.entries.empty());
+    CHECK(diff.totalDelta == 0);
+    CHECK(diff.comparedDirectories == 1);
+    CHECK(diff.prunedDirectories == 4);
+
+    FolderSizeResult failed(nullptr, INVALID_NODE, 0.0);
+    CHECK(FolderSizeResult::diff(failed, after()).entries.empty());
+}
+
+} // namespace
+
+int main() {
+    testChanges();
+    testOptions();
+    testEqualTotalsAreStillWalked();
+    testIdenticalTrees();
+    return testResult();
+}
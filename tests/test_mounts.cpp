@@ -0,0 +1,98 @@
+/*
+ * test_mounts.cpp
+ *
+ * MountTable::fromMountInfo: field parsing, path unescaping, skipped
+ * filesystem types and malformed lines.
+ */
+
+#include "fzc_mounts.hpp"
+#include "test_check.hpp"
+#ifdef __linux__
+#include <sys/sysmacros.h>
+#endif
+
+namespace {
+
+#ifdef __linux__
+
+void testParsesEntries() {
+    MountTable table = MountTable::fromMountInfo(
+        "22 1 8:1 / / rw,relatime shared:1 - ext4 /dev/sda1 rw\n"
+        "36 22 98:0 /mnt1 /mnt/parent rw,noatime master:1 propagate_from:2 - ext3 /dev/root rw,errors=continue\n"
+        "40 22 0:21 / /proc rw,nosuid - proc proc rw\n"
+        "41 22 0:45 / /home/share rw - nfs4 server:/export rw,vers=4.2\n"
+        "42 22 0:30 / /tmp rw - tmpfs tmpfs rw\n");
+    const auto& entries = table.entries();
+    CHECK(entries.size() == 5);
+    if (entries.size() != 5) return;
+
+    CHECK(entries[0].path == "/" && entries[0].fsType == "ext4" && entries[0].device == makedev(8, 1));
+    CHECK(!entries[0].skipped);
+    // Any number of optional fields before the separator
+    CHECK(entries[1].path == "/mnt/parent" && entries[1].fsType == "ext3" && entries[1].device == makedev(98, 0));
+    CHECK(entries[2].fsType == "proc" && entries[2].skipped);
+    CHECK(entries[3].fsType == "nfs4" && entries[3].skipped);
+    CHECK(entries[4].fsType == "tmpfs" && !entries[4].skipped);
+
+    const MountEntry* home = table.findByDevice(makedev(0, 45));
+    CHECK(home != nullptr && home->path == "/home/share");
+    CHECK(table.findByDevice(makedev(9, 9)) == nullptr);
+    CHECK(table.isSkippedDevice(makedev(0, 21)));
+    CHECK(table.isSkippedDevice(makedev(0, 45)));
+    CHECK(!table.isSkippedDevice(makedev(8, 1)));
+    CHECK(!table.isSkippedDevice(makedev(9, 9)));
+}
+
+void testUnescapesPaths() {
+    MountTable table = MountTable::fromMountInfo(
+        "50 22 8:2 / /media/my\\040disk rw - ext4 /dev/sdb1 rw\n"
+        "51 22 8:3 / /media/tab\\011and\\134slash rw - ext4 /dev/sdb2 rw\n"
+        // Not a full octal escape: kept as is
+        "52 22 8:4 / /media/odd\\09\\04 rw - ext4 /dev/sdb3 rw\n");
+    const auto& entries = table.entries();
+    CHECK(entries.size() == 3);
+    if (entries.size() != 3) return;
+    CHECK(entries[0].path == "/media/my disk");
+    CHECK(entries[1].path == "/media/tab\tand\\slash");
+    CHECK(entries[2].path == "/media/odd\\09\\04");
+}
+
+void testFirstMountOfDeviceWins() {
+    // Bind mounts share a device; lookups return the first mount point
+    MountTable table = MountTable::fromMountInfo(
+        "60 22 8:5 / /data rw - xfs /dev/sdc1 rw\n"
+        "61 22 8:5 /sub /srv/data rw - xfs /dev/sdc1 rw\n");
+    CHECK(table.entries().size() == 2);
+    const MountEntry* entry = table.findByDevice(makedev(8, 5));
+    CHECK(entry != nullptr && entry->path == "/data");
+}
+
+void testSkipsMalformedLines() {
+    MountTable table = MountTable::fromMountInfo(
+        "\n"
+        "garbage\n"
+        "70 22 8:6 / /short\n"                              // too few fields
+        "71 22 8:7 / /nosep rw shared:1 ext4 /dev/sdd rw\n" // no separator
+        "72 22 8:8 / /notype rw -\n"                        // nothing after the separator
+        "73 22 eight:8 / /baddev rw - ext4 /dev/sde rw\n"   // device is not major:minor
+        "74 22 8:9 / /good rw - ext4 /dev/sdf rw");         // last line without a newline
+    const auto& entries = table.entries();
+    CHECK(entries.size() == 1);
+    if (entries.size() == 1) CHECK(entries[0].path == "/good" && entries[0].device == makedev(8, 9));
+
+    CHECK(MountTable::fromMountInfo("").entries().empty());
+}
+
+#endif
+
+} // namespace
+
+int main() {
+#ifdef __linux__
+    testParsesEntries();
+    testUnescapesPaths();
+    testFirstMountOfDeviceWins();
+    testSkipsMalformedLines();
+#endif
+    return testResult();
+}
@@ -0,0 +1,74 @@
+/*
+ * test_prefix.cpp
+ *
+ * PathPrefixTrie: component-wise prefix matching anchored at the root.
+ */
+
+#include "fzc_prefix.hpp"
+#include "test_check.hpp"
+
+namespace {
+
+void testCoversPrefixAndBelow() {
+    PathPrefixTrie trie;
+    CHECK(trie.empty());
+    trie.insert("/System/Volumes/Data");
+    trie.insert("/proc");
+    CHECK(!trie.empty());
+
+    CHECK(trie.covers("/proc"));
+    CHECK(trie.covers("/proc/1/status"));
+    CHECK(trie.covers("/System/Volumes/Data"));
+    CHECK(trie.covers("/System/Volumes/Data/Users/me"));
+
+    CHECK(!trie.covers("/"));
+    CHECK(!trie.covers("/System/Volumes"));
+    CHECK(!trie.covers("/System/Volumes/Preboot"));
+    // Whole components only, not string prefixes
+    CHECK(!trie.covers("/processes"));
+    CHECK(!trie.covers("/System/Volumes/DataBackup"));
+}
+
+void testSeparators() {
+    PathPrefixTrie trie;
+    trie.insert("/mnt//data/");
+    CHECK(trie.covers("/mnt/data"));
+    CHECK(trie.covers("//mnt///data//x"));
+    CHECK(trie.covers("\\mnt\\data\\x"));
+    CHECK(!trie.covers("/mnt"));
+}
+
+void testAnchoredAtRoot() {
+    PathPrefixTrie trie;
+    trie.insert("/proc");
+    // A relative path spelling out the prefix does not match
+    CHECK(!trie.covers("proc"));
+    CHECK(!trie.covers("proc/1"));
+    CHECK(!trie.covers(""));
+
+    // Relative prefixes are ignored
+    PathPrefixTrie relative;
+    relative.insert("proc");
+    relative.insert("");
+    CHECK(relative.empty());
+    CHECK(!relative.covers("/proc"));
+}
+
+void testRootCoversEverything() {
+    PathPrefixTrie trie;
+    trie.insert("/");
+    CHECK(!trie.empty());
+    CHECK(trie.covers("/"));
+    CHECK(trie.covers("/any/path"));
+    CHECK(!trie.covers("relative"));
+}
+
+} // namespace
+
+int main() {
+    testCoversPrefixAndBelow();
+    testSeparators();
+    testAnchoredAtRoot();
+    testRootCoversEverything();
+    return testResult();
+}
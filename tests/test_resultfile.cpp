@@ -0,0 +1,197 @@
+/*
+ * test_resultfile.cpp
+ *
+ * Binary result files: save and load round trip, and rejection of damaged
+ * headers, links and names.
+ */
+
+#include "fzc.hpp"
+#include "test_check.hpp"
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+// Offsets into the file as written by FolderSizeResult::save
+constexpr size_t HEADER_ROOT_INDEX = 20;
+constexpr size_t HEADER_STRING_BYTES = 32;
+constexpr size_t HEADER_BYTES = 104;
+constexpr size_t NODE_NAME_OFFSET = 8;
+constexpr size_t NODE_PARENT = 12;
+constexpr size_t NODE_FIRST_CHILD = 16;
+constexpr size_t NODE_NEXT_SIBLING = 20;
+constexpr size_t NODE_CHILD_COUNT = 24;
+constexpr size_t NODE_NAME_LENGTH = 28;
+
+std::string readFile(const std::string& file) {
+    std::ifstream in(file, std::ios::binary);
+    std::stringstream text;
+    text << in.rdbuf();
+    return text.str();
+}
+
+void writeFile(const std::string& file, const std::string& bytes) {
+    std::ofstream out(file, std::ios::binary | std::ios::trunc);
+    out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+}
+
+template <typename T>
+void patch(std::string& bytes, size_t offset, T value) {
+    std::memcpy(&bytes[offset], &value, sizeof(value));
+}
+
+size_t nodeField(NodeIndex index, size_t field) {
+    return HEADER_BYTES + index * sizeof(FileNode) + field;
+}
+
+// /data (60) -> docs (30) -> {a.txt (10), b.txt (20)}, c.txt (30)
+enum : NodeIndex { ROOT = 0, DOCS = 1, A_TXT = 2, B_TXT = 3, C_TXT = 4 };
+
+FolderSizeResult makeResult() {
+    auto tree = std::make_shared<FileTree>();
+    tree->addNode("/data", 60, true);
+    tree->addNode("docs", 30, true);
+    tree->addNode("a.txt", 10, false);
+    tree->addNode("b.txt", 20, false);
+    tree->addNode("c.txt", 30, false);
+    tree->setChildren(ROOT, std::vector<NodeIndex>{DOCS, C_TXT});
+    tree->setChildren(DOCS, std::vector<NodeIndex>{B_TXT, A_TXT});
+    tree->node(C_TXT).isSparse = true;
+    FolderSizeResult result(tree, ROOT, 12.5);
+    result.hardLinkSavings = 7;
+    result.isComplete = false;
+    result.stopReason = StopReason::Deadline;
+    result.truncatedAt = 99;
+    result.reusedDirectories = 3;
+    result.sparseFiles = 1;
+    return result;
+}
+
+void testRoundTrip(const std::string& file) {
+    FolderSizeResult saved = makeResult();
+    CHECK(saved.save(file));
+    FolderSizeResult loaded = FolderSizeResult::load(file);
+    CHECK(loaded.rootNode != nullptr);
+    if (!loaded.rootNode) return;
+    CHECK(loaded.tree->isMapped());
+    CHECK(loaded.tree->nodeCount() == 5);
+    CHECK(loaded.rootIndex == ROOT);
+    CHECK(loaded.rootNode->size == 60);
+    CHECK(loaded.elapsedTimeMs == 12.5);
+    CHECK(loaded.hardLinkSavings == 7);
+    CHECK(!loaded.isComplete);
+    CHECK(loaded.stopReason == StopReason::Deadline);
+    CHECK(loaded.truncatedAt == 99);
+    CHECK(loaded.reusedDirectories == 3);
+    CHECK(loaded.sparseFiles == 1);
+
+    const FileTree& tree = *loaded.tree;
+    CHECK(tree.path(A_TXT) == "/data/docs/a.txt");
+    CHECK(tree.node(C_TXT).isSparse);
+    CHECK(!tree.node(A_TXT).isSparse);
+    // Child order is kept as saved
+    CHECK(tree.node(DOCS).firstChild == B_TXT);
+    CHECK(tree.node(B_TXT).nextSibling == A_TXT);
+    CHECK(tree.node(ROOT).childCount == 2);
+
+    // A mapped tree cannot grow
+    bool threw = false;
+    try {
+        loaded.tree->addNode("new", 1, false);
+    } catch (const std::logic_error&) {
+        threw = true;
+    }
+    CHECK(threw);
+
+    CHECK(FolderSizeResult::load(file + ".missing").rootNode == nullptr);
+}
+
+void expectRejected(const std::string& file, const std::string& bytes, const char* what) {
+    writeFile(file, bytes);
+    if (FolderSizeResult::load(file).rootNode != nullptr) {
+        std::fprintf(stderr, "damaged result file accepted: %s\n", what);
+        ++testFailures();
+    }
+}
+
+void testDamagedFilesRejected(const std::string& file) {
+    CHECK(makeResult().save(file));
+    const std::string good = readFile(file);
+    CHECK(good.size() > HEADER_BYTES + 5 * sizeof(FileNode));
+    if (good.size() <= HEADER_BYTES + 5 * sizeof(FileNode)) return;
+
+    // A harmless edit at the same offsets loads, so the offsets below hit the intended fields
+    std::string edited = good;
+    patch<uint64_t>(edited, nodeField(C_TXT, 0), 31);
+    writeFile(file, edited);
+    FolderSizeResult reloaded = FolderSizeResult::load(file);
+    CHECK(reloaded.rootNode != nullptr && reloaded.tree->node(C_TXT).size == 31);
+
+    expectRejected(file, good.substr(0, HEADER_BYTES - 1), "truncated header");
+    expectRejected(file, good.substr(0, good.size() - 4), "truncated name table");
+
+    std::string bytes = good;
+    bytes[1] = 'X';
+    expectRejected(file, bytes, "bad magic");
+
+    bytes = good;
+    patch<uint32_t>(bytes, HEADER_ROOT_INDEX, 5);
+    expectRejected(file, bytes, "root index out of range");
+
+    bytes = good;
+    patch<uint64_t>(bytes, HEADER_STRING_BYTES, good.size());
+    expectRejected(file, bytes, "name table past the end of the file");
+
+    bytes = good;
+    patch<uint32_t>(bytes, nodeField(DOCS, NODE_PARENT), 1000);
+    expectRejected(file, bytes, "parent out of range");
+
+    bytes = good;
+    patch<uint32_t>(bytes, nodeField(C_TXT, NODE_FIRST_CHILD), 5);
+    expectRejected(file, bytes, "first child out of range");
+
+    bytes = good;
+    patch<uint32_t>(bytes, nodeField(B_TXT, NODE_NEXT_SIBLING), B_TXT);
+    expectRejected(file, bytes, "sibling cycle");
+
+    bytes = good;
+    patch<uint32_t>(bytes, nodeField(DOCS, NODE_FIRST_CHILD), ROOT);
+    patch<uint32_t>(bytes, nodeField(DOCS, NODE_CHILD_COUNT), 1);
+    expectRejected(file, bytes, "directory cycle through the root");
+
+    bytes = good;
+    patch<uint32_t>(bytes, nodeField(A_TXT, NODE_PARENT), C_TXT);
+    expectRejected(file, bytes, "child naming another parent");
+
+    bytes = good;
+    patch<uint32_t>(bytes, nodeField(ROOT, NODE_CHILD_COUNT), 3);
+    expectRejected(file, bytes, "child count larger than the list");
+
+    bytes = good;
+    patch<uint32_t>(bytes, nodeField(ROOT, NODE_PARENT), DOCS);
+    expectRejected(file, bytes, "root with a parent");
+
+    bytes = good;
+    patch<uint32_t>(bytes, nodeField(C_TXT, NODE_NAME_OFFSET), 0xfffffff0);
+    expectRejected(file, bytes, "name outside the table");
+
+    bytes = good;
+    patch<uint16_t>(bytes, nodeField(A_TXT, NODE_NAME_LENGTH), 3);
+    expectRejected(file, bytes, "name without its terminator");
+
+    // The untouched file still loads
+    writeFile(file, good);
+    CHECK(FolderSizeResult::load(file).rootNode != nullptr);
+}
+
+} // namespace
+
+int main() {
+    std::string work = makeTempDir();
+    std::string file = work + "/result.fzc";
+    testRoundTrip(file);
+    testDamagedFilesRejected(file);
+    fs::remove_all(work);
+    return testResult();
+}
@@ -0,0 +1,153 @@
+/*
+ * test_snapshot.cpp
+ *
+ * ScanSnapshot: write, reuse on the next scan, and rejection of damaged files.
+ */
+
+#include "fzc.hpp"
+#include "fzc_snapshot.hpp"
+#include "test_check.hpp"
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+// Offsets into the file as written by ScanSnapshot::write
+constexpr size_t HEADER_BYTES = 72;
+constexpr size_t NODE_NAME_OFFSET = 8;
+constexpr size_t NODE_FIRST_CHILD = 12;
+
+std::string readFile(const std::string& file) {
+    std::ifstream in(file, std::ios::binary);
+    std::stringstream text;
+    text << in.rdbuf();
+    return text.str();
+}
+
+void writeFile(const std::string& file, const std::string& bytes) {
+    std::ofstream out(file, std::ios::binary | std::ios::trunc);
+    out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+}
+
+void patchUint32(std::string& bytes, size_t offset, uint32_t value) {
+    std::memcpy(&bytes[offset], &value, sizeof(value));
+}
+
+// root/{a.bin (100), sub/{b.bin (200), deep/c.bin (300)}, other/d.bin (400)}
+void makeTree(const std::string& root) {
+    fs::create_directories(root + "/sub/deep");
+    fs::create_directories(root + "/other");
+    writeFile(root + "/a.bin", std::string(100, 'a'));
+    writeFile(root + "/sub/b.bin", std::string(200, 'b'));
+    writeFile(root + "/sub/deep/c.bin", std::string(300, 'c'));
+    writeFile(root + "/other/d.bin", std::string(400, 'd'));
+}
+
+void testRoundTripAndReuse(const std::string& root, const std::string& snapshotFile) {
+    FZC scanner(true, 2, false, false);
+    scanner.setSnapshotPath(snapshotFile);
+
+    FolderSizeResult first = scanner.calculateFolderSizes(root);
+    CHECK(first.rootNode != nullptr);
+    if (!first.rootNode) return;
+    CHECK(first.rootNode->size == 1000);
+    CHECK(first.reusedDirectories == 0);
+    CHECK(fs::exists(snapshotFile));
+
+    // The file maps back with sorted children and a record for every directory
+    auto snapshot = ScanSnapshot::open(snapshotFile, root, 0);
+    CHECK(snapshot != nullptr);
+    if (snapshot) {
+        const SnapshotNode& top = snapshot->node(ScanSnapshot::ROOT);
+        CHECK(top.isDirectory && top.childCount == 3 && top.size == 1000);
+        CHECK(snapshot->record(top) != nullptr);
+        NodeIndex sub = snapshot->findChild(ScanSnapshot::ROOT, "sub");
+        CHECK(sub != INVALID_NODE);
+        if (sub != INVALID_NODE) {
+            CHECK(snapshot->node(sub).size == 500);
+            CHECK(snapshot->findChild(sub, "b.bin") != INVALID_NODE);
+        }
+        CHECK(snapshot->findChild(ScanSnapshot::ROOT, "missing") == INVALID_NODE);
+    }
+    // Written for another root or other size options: ignored
+    CHECK(ScanSnapshot::open(snapshotFile, root + "/sub", 0) == nullptr);
+    CHECK(ScanSnapshot::open(snapshotFile, root, SNAPSHOT_ALLOCATED_SIZE) == nullptr);
+    snapshot.reset();
+
+    // Nothing changed: every directory comes from the snapshot, sizes agree
+    FolderSizeResult second = scanner.calculateFolderSizes(root);
+    CHECK(second.rootNode != nullptr);
+    if (!second.rootNode) return;
+    CHECK(second.rootNode->size == 1000);
+    CHECK(second.reusedDirectories == 4);
+
+    // A new file in one directory is picked up; the rest is still reused
+    writeFile(root + "/sub/deep/e.bin", std::string(50, 'e'));
+    FolderSizeResult third = scanner.calculateFolderSizes(root);
+    CHECK(third.rootNode != nullptr);
+    if (!third.rootNode) return;
+    CHECK(third.rootNode->size == 1050);
+    CHECK(third.reusedDirectories > 0 && third.reusedDirectories < 4);
+}
+
+void testDamagedFilesRejected(const std::string& root, const std::string& snapshotFile) {
+    const std::string good = readFile(snapshotFile);
+    CHECK(good.size() > HEADER_BYTES);
+    if (good.size() <= HEADER_BYTES) return;
+    CHECK(ScanSnapshot::open(snapshotFile, root, 0) != nullptr);
+
+    std::string bytes = good.substr(0, HEADER_BYTES / 2);
+    writeFile(snapshotFile, bytes);
+    CHECK(ScanSnapshot::open(snapshotFile, root, 0) == nullptr);
+
+    bytes = good.substr(0, good.size() - 8);
+    writeFile(snapshotFile, bytes);
+    CHECK(ScanSnapshot::open(snapshotFile, root, 0) == nullptr);
+
+    bytes = good;
+    bytes[0] = 'X';
+    writeFile(snapshotFile, bytes);
+    CHECK(ScanSnapshot::open(snapshotFile, root, 0) == nullptr);
+
+    // Root listing itself as its own child
+    bytes = good;
+    patchUint32(bytes, HEADER_BYTES + NODE_FIRST_CHILD, 0);
+    writeFile(snapshotFile, bytes);
+    CHECK(ScanSnapshot::open(snapshotFile, root, 0) == nullptr);
+
+    // Child range past the end of the node array
+    bytes = good;
+    patchUint32(bytes, HEADER_BYTES + NODE_FIRST_CHILD, 0x7fffffff);
+    writeFile(snapshotFile, bytes);
+    CHECK(ScanSnapshot::open(snapshotFile, root, 0) == nullptr);
+
+    // Name outside the string table
+    bytes = good;
+    patchUint32(bytes, HEADER_BYTES + NODE_NAME_OFFSET, 0xfffffff0);
+    writeFile(snapshotFile, bytes);
+    CHECK(ScanSnapshot::open(snapshotFile, root, 0) == nullptr);
+
+    // A scan over a damaged snapshot falls back to a full walk and rewrites it
+    FZC scanner(true, 2, false, false);
+    scanner.setSnapshotPath(snapshotFile);
+    FolderSizeResult result = scanner.calculateFolderSizes(root);
+    CHECK(result.rootNode != nullptr);
+    if (!result.rootNode) return;
+    CHECK(result.rootNode->size == 1050);
+    CHECK(result.reusedDirectories == 0);
+    CHECK(ScanSnapshot::open(snapshotFile, root, 0) != nullptr);
+}
+
+} // namespace
+
+int main() {
+    std::string work = makeTempDir();
+    std::string root = work + "/tree";
+    std::string snapshotFile = work + "/scan.snapshot";
+    makeTree(root);
+    testRoundTripAndReuse(root, snapshotFile);
+    testDamagedFilesRejected(root, snapshotFile);
+    fs::remove_all(work);
+    return testResult();
+}
@@ -0,0 +1,61 @@
+/*
+ * test_topk.cpp
+ *
+ * TopKCollector: bounded per-slot heaps and the final merge.
+ */
+
+#include "fzc_topk.hpp"
+#include "test_check.hpp"
+
+namespace {
+
+void testKeepsLargestAcrossSlots() {
+    TopKCollector collector(3, 2);
+    collector.offerFile(0, "/data", "a", 10);
+    collector.offerFile(0, "/data", "b", 50);
+    collector.offerFile(1, "/data/sub", "c", 30);
+    collector.offerFile(1, "/data/sub", "d", 40);
+    collector.offerFile(0, "/data/", "e", 5);
+    collector.offerFile(1, "/data", "f", 60);
+
+    std::vector<TopKEntry> files = collector.takeFiles();
+    CHECK(files.size() == 3);
+    if (files.size() == 3) {
+        CHECK(files[0].path == "/data/f" && files[0].size == 60);
+        CHECK(files[1].path == "/data/b" && files[1].size == 50);
+        CHECK(files[2].path == "/data/sub/d" && files[2].size == 40);
+    }
+    // Taking empties the slots
+    CHECK(collector.takeFiles().empty());
+}
+
+void testTiesOrderedByPath() {
+    TopKCollector collector(4, 1);
+    collector.offerDirectory(0, "/x/b", 7);
+    collector.offerDirectory(0, "/x/a", 7);
+    collector.offerDirectory(0, "/x/c", 9);
+    std::vector<TopKEntry> directories = collector.takeDirectories();
+    CHECK(directories.size() == 3);
+    if (directories.size() == 3) {
+        CHECK(directories[0].path == "/x/c");
+        CHECK(directories[1].path == "/x/a");
+        CHECK(directories[2].path == "/x/b");
+    }
+}
+
+void testZeroK() {
+    TopKCollector collector(0, 1);
+    collector.offerFile(0, "/", "a", 1);
+    collector.offerDirectory(0, "/a", 1);
+    CHECK(collector.takeFiles().empty());
+    CHECK(collector.takeDirectories().empty());
+}
+
+} // namespace
+
+int main() {
+    testKeepsLargestAcrossSlots();
+    testTiesOrderedByPath();
+    testZeroK();
+    return testResult();
+}
@@ -0,0 +1,97 @@
+/*
+ * test_tree.cpp
+ *
+ * FileTree: node storage, child linking and path reconstruction.
+ */
+
+#include "fzc.hpp"
+#include "test_check.hpp"
+
+namespace {
+
+void testAddNode() {
+    FileTree tree;
+    NodeIndex root = tree.addNode("/data", 10, true);
+    NodeIndex file = tree.addNode("notes.txt", 42, false);
+    CHECK(tree.nodeCount() == 2);
+    const FileNode& node = tree.node(file);
+    CHECK(node.size == 42);
+    CHECK(!node.isDirectory);
+    CHECK(node.isComplete);
+    CHECK(node.parent == INVALID_NODE && node.firstChild == INVALID_NODE && node.nextSibling == INVALID_NODE);
+    CHECK(tree.nameView(node) == "notes.txt");
+    CHECK(tree.nameView(tree.node(root)) == "/data");
+    CHECK(tree.node(root).isDirectory);
+}
+
+void testSetChildrenKeepsOrder() {
+    FileTree tree;
+    NodeIndex root = tree.addNode("/data", 0, true);
+    NodeIndex a = tree.addNode("a", 1, false);
+    NodeIndex b = tree.addNode("b", 2, false);
+    NodeIndex c = tree.addNode("c", 3, false);
+    std::vector<NodeIndex> children{c, a, b};
+    tree.setChildren(root, children);
+
+    CHECK(tree.node(root).childCount == 3);
+    std::vector<NodeIndex> walked;
+    for (NodeIndex child = tree.node(root).firstChild; child != INVALID_NODE; child = tree.node(child).nextSibling) {
+        CHECK(tree.node(child).parent == root);
+        walked.push_back(child);
+    }
+    CHECK(walked == children);
+
+    // Relinking replaces the previous list
+    std::vector<NodeIndex> fewer{b};
+    tree.setChildren(root, fewer);
+    CHECK(tree.node(root).childCount == 1);
+    CHECK(tree.node(root).firstChild == b);
+    CHECK(tree.node(b).nextSibling == INVALID_NODE);
+}
+
+void testPath() {
+    FileTree tree;
+    NodeIndex root = tree.addNode("/data", 0, true);
+    NodeIndex dir = tree.addNode("photos", 0, true);
+    NodeIndex file = tree.addNode("cat.jpg", 5, false);
+    tree.setChildren(root, std::vector<NodeIndex>{dir});
+    tree.setChildren(dir, std::vector<NodeIndex>{file});
+    CHECK(tree.path(root) == "/data");
+    CHECK(tree.path(dir) == "/data/photos");
+    CHECK(tree.path(file) == "/data/photos/cat.jpg");
+
+    // A root with a trailing separator does not double it
+    FileTree top;
+    NodeIndex slash = top.addNode("/", 0, true);
+    NodeIndex etc = top.addNode("etc", 0, true);
+    top.setChildren(slash, std::vector<NodeIndex>{etc});
+    CHECK(top.path(etc) == "/etc");
+}
+
+void testGrowsAcrossChunks() {
+    // Well past the first node chunk (1024) and string chunk (64 KB)
+    FileTree tree;
+    const uint32_t count = 20000;
+    for (uint32_t i = 0; i < count; ++i) {
+        tree.addNode("entry_" + std::to_string(i), i, false);
+    }
+    CHECK(tree.nodeCount() == count);
+    bool intact = true;
+    for (uint32_t i = 0; i < count; ++i) {
+        const FileNode& node = tree.node(i);
+        if (node.size != i || tree.nameView(node) != "entry_" + std::to_string(i) || tree.name(node)[node.nameLength] != '\0') {
+            intact = false;
+        }
+    }
+    CHECK(intact);
+}
+
+} // namespace
+
+int main() {
+    testAddNode();
+    testSetChildrenKeepsOrder();
+    testPath();
+    testGrowsAcrossChunks();
+    return testResult();
+}